@@ -41,7 +41,11 @@ graph_files := $(core_src)/graph/gigraph.cpp \
               $(core_src)/graph/gipath.cpp \
               $(core_src)/graph/gixform.cpp
 
-json_files := $(core_src)/jsonstorage/mgjsonstorage.cpp
+json_files := $(core_src)/jsonstorage/mgjsonstorage.cpp \
+              $(core_src)/jsonstorage/mgjsonwriter.cpp \
+              $(core_src)/storage/mgbinstorage.cpp \
+              $(core_src)/storage/mgjsonreader.cpp \
+              $(core_src)/storage/mgmappedfile.cpp
 
 shape_files := $(core_src)/shape/mgcomposite.cpp \
               $(core_src)/shape/mgellipse.cpp \
@@ -52,6 +56,7 @@ shape_files := $(core_src)/shape/mgcomposite.cpp \
               $(core_src)/shape/mgrect.cpp \
               $(core_src)/shape/mgshape.cpp \
               $(core_src)/shape/mgshapes.cpp \
+              $(core_src)/shape/mgboxselector.cpp \
               $(core_src)/shape/mgsplines.cpp \
               $(core_src)/shape/mgbasicspreg.cpp
 
@@ -60,6 +65,7 @@ doc_files  := $(core_src)/shapedoc/mgshapedoc.cpp \
               $(core_src)/shapedoc/spfactoryimpl.cpp
 
 test_files := $(core_src)/test/testcanvas.cpp \
+              $(core_src)/test/testbench.cpp \
               $(core_src)/test/RandomShape.cpp
 
 base_files := $(core_src)/cmdbase/mgcmddraw.cpp \
@@ -95,7 +101,9 @@ view_files := $(core_src)/view/GcGraphView.cpp \
               $(core_src)/view/gicorerecord.cpp \
               $(core_src)/export/svgcanvas.cpp \
               $(core_src)/export/girecordcanvas.cpp \
-              $(core_src)/record/recordshapes.cpp
+              $(core_src)/record/recordshapes.cpp \
+              $(core_src)/record/recordindex.cpp \
+              $(core_src)/record/recordpack.cpp
 
 include $(CLEAR_VARS)
 LOCAL_MODULE     := libTouchVGCore
@@ -123,6 +123,16 @@ public:
      */
     virtual float drawTextAt(const char* text, float x, float y, float h, int align) = 0;
     
+    //! Draw a region of the main view's cached bitmap scaled into `rect' of this canvas.
+    /*! The magnifier view calls it to reuse the content already rendered by the main view
+        instead of drawing all shapes again.
+        \param srcx, srcy, srcw, srch The region in the main view's cached bitmap, in point unit.
+        \param x, y, w, h The destination rect in this canvas, in point unit.
+        \return false if no cached bitmap is available, then the shapes will be drawn.
+     */
+    virtual bool drawCachedBitmap(float srcx, float srcy, float srcw, float srch,
+                                  float x, float y, float w, float h) { return false; }
+    
 #ifndef SWIG
     //! Clear the cached bitmap for re-drawing on desktop PC.
     virtual void clearCachedBitmap(bool clearAll = false) {}
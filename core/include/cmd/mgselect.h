@@ -32,6 +32,8 @@ struct MgSelection {
     virtual int getSelection(MgView* view, int count, const MgShape** shapes) = 0;
     //! 得到当前选择的图形，用于修改
     virtual int getSelectionForChange(MgView* view, int count, MgShape** shapes) = 0;
+    //! 得到当前选择的图形数组，不复制，在图形列表或选择集改变前有效
+    virtual const MgShape* const* getSelectionSpan(MgView* view, int& count) = 0;
 #endif
 #ifdef SWIG_MGVECTOR_H
     //! 得到当前选择的图形
@@ -82,7 +82,11 @@ struct MgView
     virtual bool shapeCanTransform(const MgShape* shape) = 0;   //!< 通知是否能对图形变形
     virtual bool shapeCanUnlock(const MgShape* shape) = 0;      //!< 通知是否能对图形解锁
     virtual bool shapeCanUngroup(const MgShape* shape) = 0;     //!< 通知是否能对成组图形解散
-    virtual void shapeMoved(MgShape* shape, int segment) = 0;   //!< 通知图形已拖动
+    //! 通知图形已拖动，拖动中每帧都通知
+    /*! 整体拖动多个图形时只改变换矩阵，拖动中每帧通知的图形坐标仍是拖动前的，
+        松开或结束拖动时变换图形后再通知一次最终位置，segment都为-1
+    */
+    virtual void shapeMoved(MgShape* shape, int segment) = 0;
     
     //! 图形点击的通知，返回false继续显示上下文按钮
     virtual bool shapeClicked(int sid, int tag, float x, float y) = 0;
@@ -94,6 +98,9 @@ struct MgView
             const Box2d& selbox, const MgShape* shape) = 0;     //!< 显示上下文菜单
     virtual bool registerCommand(const char* name, MgCommand* (*creator)()) = 0; //!< 注册命令
     virtual const char* getCommandName() = 0;                   //!< 得到当前命令名称
+    
+    //! 删除当前图形列表中的多个图形，跳过重复的、锁定的和 shapeWillDeleted() 拒绝的图形，只通知一次. 返回删除的个数
+    virtual int removeShapes(const int* ids, int count) = 0;
 #endif
 };
 
@@ -7,6 +7,7 @@
 #define TOUCHVG_CMD_DRAW_FREELINES_H_
 
 #include "mgcmddraw.h"
+#include <vector>
 
 //! 自由折线绘图命令类
 /*! \ingroup CORE_COMMAND
@@ -19,7 +20,7 @@ public:
     static MgCommand* Create() { return new MgCmdDrawFreeLines; }
     
 private:
-    MgCmdDrawFreeLines() : MgCommandDraw(Name()) {}
+    MgCmdDrawFreeLines() : MgCommandDraw(Name()), m_minDist(0.5f), m_tolerance(0.2f) {}
     virtual void release() { delete this; }
     
     virtual bool initialize(const MgMotion* sender, MgStorage* s);
@@ -31,6 +32,10 @@ private:
     
 private:
     bool canAddPoint(const MgMotion* sender, bool ended);
+    
+    float   m_minDist;      // 相邻顶点的最小距离，显示毫米
+    float   m_tolerance;    // 去掉的采样点到折线的最大距离，显示毫米，为0则只按距离过滤
+    std::vector<Point2d>    m_samples;  // 最后一个顶点之后的采样点
 };
 
 #endif // TOUCHVG_CMD_DRAW_FREELINES_H_
@@ -7,6 +7,7 @@
 #define TOUCHVG_CMD_DRAW_SPLINES_H_
 
 #include "mgcmddraw.h"
+#include "mgcurv.h"
 
 //! 样条曲线绘图命令类
 /*! \ingroup CORE_COMMAND
@@ -37,8 +38,11 @@ private:
     
 private:
     bool canAddPoint(const MgMotion* sender, bool ended);
+    void addFitPoint(const MgMotion* sender, const Point2d& pnt);
+    void smoothStroke(const MgMotion* sender);
     
     bool    m_freehand;
+    MgCurveFitter   m_fitter;   // 徒手绘制时边输入点边拟合
 };
 
 //! 用点击绘制样条曲线的命令类
@@ -59,11 +59,16 @@ struct CmdObserver {
     virtual void onShapeAdded(const MgMotion* sender, MgShape* sp) = 0;        //!< 通知已添加图形
     virtual bool onShapeWillDeleted(const MgMotion* sender, const MgShape* sp) = 0;  //!< 通知将删除图形
     virtual void onShapeDeleted(const MgMotion* sender, const MgShape* sp) = 0;      //!< 通知已删除图形
+#ifndef SWIG
+    //! 批量删除图形的通知，此时图形尚未释放
+    virtual void onShapesDeleted(const MgMotion* sender, int count, const MgShape* const* shapes) = 0;
+#endif
     virtual bool onShapeCanRotated(const MgMotion* sender, const MgShape* sp) = 0;   //!< 通知是否能旋转图形
     virtual bool onShapeCanTransform(const MgMotion* sender, const MgShape* sp) = 0; //!< 通知是否能对图形变形
     virtual bool onShapeCanUnlock(const MgMotion* sender, const MgShape* sp) = 0;    //!< 通知是否能对图形解锁
     virtual bool onShapeCanUngroup(const MgMotion* sender, const MgShape* sp) = 0;   //!< 通知是否能对成组图形解散
-    virtual void onShapeMoved(const MgMotion* sender, MgShape* sp, int segment) = 0;   //!< 通知图形已拖动
+    //! 通知图形已拖动，拖动中每帧都通知，整体拖动多个图形时图形坐标在最后一次通知时才是变换后的
+    virtual void onShapeMoved(const MgMotion* sender, MgShape* sp, int segment) = 0;
 
     virtual MgBaseShape* createShape(const MgMotion* sender, int type) = 0; //!< 创建自定义的图形
     virtual MgCommand* createCommand(const MgMotion* sender, const char* name) = 0; //!< 创建命令
@@ -101,6 +106,11 @@ public:
     virtual int addShapeActions(const MgMotion*,mgvector<int>&,int n, const MgShape*) { return n; }
 #ifndef SWIG
     virtual void onSelectTouchEnded(const MgMotion*,int,int,int,int,int,const int*) {}
+    virtual void onShapesDeleted(const MgMotion* sender, int count, const MgShape* const* shapes) {
+        for (int i = 0; i < count; i++) {
+            onShapeDeleted(sender, shapes[i]);
+        }
+    }
 #endif
 };
 
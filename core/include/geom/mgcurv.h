@@ -192,10 +192,25 @@ static int insectTwoCircles(Point2d& pt1, Point2d& pt2,
     \param[in] c 系数矩阵中的右对角线元素数组，c[0..n-2]
     \param[in,out] vs 输入方程组等号右边的已知n个矢量，输出求解出的未知矢量
     \return 是否求解成功，失败原因可能是参数错误或因系数矩阵非主角占优而出现除零
-    \see gaussJordan
+    \see gaussJordan, cyclicTriEquations
 */
 static bool triEquations(int n, float *a, float *b, float *c, Vector2d *vs);
 
+//! 求解周期三对角线方程组
+/*! 在三对角线方程组的基础上，右上角元素为a[n-1]，左下角元素为c[n-1]，即第i行为 \n
+    a[(i+n-1)%n] * x[(i+n-1)%n] + b[i] * x[i] + c[i] * x[(i+1)%n] = r[i] \n
+    用Sherman-Morrison公式化为三对角线方程组求解，计算量和内存为O(n)。
+
+    \param[in] n 方程组阶数，最小为2
+    \param[in] a 系数矩阵中的左对角线元素数组，a[0..n-2]，a[n-1]为右上角元素
+    \param[in,out] b 系数矩阵中的中对角线元素数组，b[0..n-1]，会被修改
+    \param[in] c 系数矩阵中的右对角线元素数组，c[0..n-2]，c[n-1]为左下角元素
+    \param[in,out] vs 输入方程组等号右边的已知n个矢量，输出求解出的未知矢量
+    \return 是否求解成功，失败原因可能是参数错误或因系数矩阵非主角占优而出现除零
+    \see triEquations
+*/
+static bool cyclicTriEquations(int n, float *a, float *b, float *c, Vector2d *vs);
+
 //! Gauss-Jordan法求解线性方程组
 /*!
     \param[in] n 方程组阶数，最小为2
@@ -306,4 +321,55 @@ static void fitClampedSpline(const Point2d* knots, int i, float t, float sigma,
 #endif
 };
 
+#ifndef SWIG
+#include <vector>
+
+//! 边输入数据点边光滑拟合为三次贝塞尔曲线
+/*! 前部已拟合稳定的曲线段冻结后不再重新拟合，只对末尾未冻结的数据点重新拟合，
+    因此结束时的拟合时间有上限，每段曲线的拟合误差与 mgcurv::fitCurve 相同。
+    \ingroup GEOMAPI
+    \see mgcurv::fitCurve
+*/
+class MgCurveFitter
+{
+public:
+    MgCurveFitter() : _tol(0), _start(0), _fixed(0), _fitted(0) {}
+    
+    //! 清除数据点和拟合结果，设置拟合曲线与数据点的最大允许距离
+    void clear(float tol);
+    
+    //! 添加数据点，积累一定点数后拟合并冻结前部曲线段
+    void addPoint(const Point2d& pt);
+    
+    //! 拟合末尾未冻结的数据点，返回拟合的顶点数，数据点少于3个则返回0
+    int end();
+    
+    //! 返回数据点数
+    int getPointCount() const { return (int)_pts.size(); }
+    
+    //! 返回拟合的顶点数
+    int getKnotCount() const { return (int)_knots.size(); }
+    
+    //! 返回拟合的贝塞尔曲线顶点
+    const Point2d* getKnots() const { return _knots.empty() ? (const Point2d*)0 : &_knots.front(); }
+    
+    //! 返回拟合的顶点处的切向矢量
+    const Vector2d* getKnotVectors() const { return _knotvs.empty() ? (const Vector2d*)0 : &_knotvs.front(); }
+    
+private:
+    void fitTail(bool ended);
+    void fitRange(int last, bool split);
+    static void appendCurve(void* data, const Point2d curve[4], int last);
+    
+    std::vector<Point2d>    _pts;       // 数据点
+    std::vector<Point2d>    _knots;     // 拟合的顶点，前_fixed个已冻结
+    std::vector<Vector2d>   _knotvs;    // 顶点处的切向矢量
+    std::vector<int>        _indices;   // 顶点对应的数据点序号
+    float   _tol;
+    int     _start;                     // 最后一个冻结顶点对应的数据点序号
+    int     _fixed;                     // 冻结的顶点数
+    int     _fitted;                    // 上次拟合时的数据点数
+};
+#endif // SWIG
+
 #endif // TOUCHVG_FITCURVE_H_
@@ -266,6 +266,15 @@ static int ptInArea(
     \return 是否为凸多边形
 */
 static bool isConvex(int count, const Point2d* vertexs, bool* pACW = (bool*)0);
+
+//! 用Douglas-Peucker算法化简折线
+/*! 保留首末点，去掉到所在化简线段的距离都不超过容差的中间顶点
+    \param[in] count 顶点个数
+    \param[in,out] points 顶点数组，化简后保留的顶点依次移到前面
+    \param[in] tol 顶点到化简后折线的最大允许距离
+    \return 化简后的顶点个数
+*/
+static int simplifyLines(int count, Point2d* points, float tol);
 #endif
 };
 
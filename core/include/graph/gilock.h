@@ -1,5 +1,5 @@
 ﻿//! \file gilock.h
-//! \brief 定义原子锁函数 giAtomicIncrement, giAtomicDecrement, giAtomicCompareAndSwap
+//! \brief 定义原子锁函数 giAtomicIncrement, giAtomicDecrement, giAtomicCompareAndSwap, giMemoryBarrier
 // Copyright (c) 2004-2013, Zhang Yungui
 // License: LGPL, https://github.com/rhcad/touchvg
 
@@ -13,6 +13,7 @@
     inline long giAtomicDecrement(volatile long *p) { return OSAtomicDecrement32((volatile int32_t *)p); }
     inline bool giAtomicCompareAndSwap(volatile long *p, long value, long oldValue) {
         return OSAtomicCompareAndSwapLong(oldValue, value, p); }
+    inline void giMemoryBarrier() { OSMemoryBarrier(); }
 #elif defined(__WINDOWS__) || defined(WIN32)
     #ifndef _WINDOWS_
         #define WIN32_LEAN_AND_MEAN
@@ -23,22 +24,26 @@
         inline long giAtomicDecrement(volatile long *p) { return InterlockedDecrement((long*)p); }
         inline bool giAtomicCompareAndSwap(volatile long *p, long value, long oldValue) {
             return InterlockedCompareExchange((long*)p, value, oldValue) == oldValue; }
+        inline void giMemoryBarrier() { long t = 0; InterlockedExchange(&t, 1); }
     #else
         inline long giAtomicIncrement(volatile long *p) { return InterlockedIncrement(p); }
         inline long giAtomicDecrement(volatile long *p) { return InterlockedDecrement(p); }
         inline bool giAtomicCompareAndSwap(volatile long *p, long value, long oldValue) {
             return InterlockedCompareExchange(p, value, oldValue) == oldValue; }
+        inline void giMemoryBarrier() { MemoryBarrier(); }
     #endif
 #elif defined(__ANDROID__) || defined(__linux__)
     inline long giAtomicIncrement(volatile long *p) { return __sync_add_and_fetch(p, 1L); }
     inline long giAtomicDecrement(volatile long *p) { return __sync_sub_and_fetch(p, 1L); }
     inline bool giAtomicCompareAndSwap(volatile long *p, long value, long oldValue) {
         return __sync_bool_compare_and_swap(p, oldValue, value); }
+    inline void giMemoryBarrier() { __sync_synchronize(); }
 #else
     inline long giAtomicIncrement(volatile long *p) { return ++(*p); }
     inline long giAtomicDecrement(volatile long *p) { return --(*p); }
     inline bool giAtomicCompareAndSwap(volatile long *p, long value, long oldValue) {
         bool b = *p == oldValue; if (b) *p = value; return oldValue; }
+    inline void giMemoryBarrier() {}
 #endif
 #endif // SWIG
 
@@ -0,0 +1,239 @@
+﻿//! \file githread.h
+//! \brief 定义工作线程类 GiThread、互斥锁类 GiMutex、线程通知类 GiSignal、无锁队列模板类 GiRingQueue、休眠函数 giSleep、计时函数 giTickCount 和处理器核数函数 giProcessorCount
+// Copyright (c) 2004-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_GITHREAD_H_
+#define TOUCHVG_GITHREAD_H_
+
+#ifndef SWIG
+#include "gilock.h"
+
+#if defined(__WINDOWS__) || defined(WIN32)
+    #ifndef _WINDOWS_
+        #define WIN32_LEAN_AND_MEAN
+        #include <windows.h>
+    #endif
+    inline void giSleep(int ms) { Sleep(ms); }
+    inline double giTickCount() {           //!< 返回毫秒数，用于计时
+        LARGE_INTEGER freq, t;
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&t);
+        return (double)t.QuadPart * 1000.0 / (double)freq.QuadPart;
+    }
+    inline int giProcessorCount() {         //!< 返回处理器核数
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        return si.dwNumberOfProcessors > 0 ? (int)si.dwNumberOfProcessors : 1;
+    }
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+    #include <sys/time.h>
+    inline void giSleep(int ms) { usleep(ms * 1000); }
+    inline double giTickCount() {           //!< 返回毫秒数，用于计时
+        struct timeval t;
+        gettimeofday(&t, NULL);
+        return t.tv_sec * 1000.0 + t.tv_usec / 1000.0;
+    }
+    inline int giProcessorCount() {         //!< 返回处理器核数
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        return n > 0 ? (int)n : 1;
+    }
+#endif
+
+//! 工作线程类，启动后在新线程中执行给定的函数
+/*! \ingroup GRAPH_INTERFACE
+ */
+class GiThread
+{
+public:
+    typedef void (*Proc)(void* param);      //!< 线程函数
+    
+    GiThread() : _proc(NULL), _param(NULL), _started(false) {}
+    ~GiThread() { join(); }
+    
+    //! 启动线程执行给定的函数，已启动则返回false
+    bool start(Proc proc, void* param) {
+        if (_started || !proc)
+            return false;
+        _proc = proc;
+        _param = param;
+#if defined(__WINDOWS__) || defined(WIN32)
+        _handle = CreateThread(NULL, 0, run, this, 0, NULL);
+        _started = (_handle != NULL);
+#else
+        _started = (pthread_create(&_handle, NULL, run, this) == 0);
+#endif
+        return _started;
+    }
+    
+    //! 等待线程函数执行完成
+    void join() {
+        if (_started) {
+#if defined(__WINDOWS__) || defined(WIN32)
+            WaitForSingleObject(_handle, INFINITE);
+            CloseHandle(_handle);
+#else
+            pthread_join(_handle, NULL);
+#endif
+            _started = false;
+        }
+    }
+    
+    //! 返回线程是否已启动且未 join()
+    bool isStarted() const { return _started; }
+    
+private:
+#if defined(__WINDOWS__) || defined(WIN32)
+    static DWORD WINAPI run(LPVOID p) { ((GiThread*)p)->_proc(((GiThread*)p)->_param); return 0; }
+    HANDLE      _handle;
+#else
+    static void* run(void* p) { ((GiThread*)p)->_proc(((GiThread*)p)->_param); return NULL; }
+    pthread_t   _handle;
+#endif
+    Proc        _proc;
+    void*       _param;
+    bool        _started;
+    
+    GiThread(const GiThread&);
+    void operator=(const GiThread&);
+};
+
+//! 互斥锁，保护多个线程共用的数据
+/*! \ingroup GRAPH_INTERFACE
+ */
+class GiMutex
+{
+public:
+#if defined(__WINDOWS__) || defined(WIN32)
+    GiMutex() { InitializeCriticalSection(&_cs); }
+    ~GiMutex() { DeleteCriticalSection(&_cs); }
+    void lock() { EnterCriticalSection(&_cs); }
+    void unlock() { LeaveCriticalSection(&_cs); }
+private:
+    CRITICAL_SECTION _cs;
+#else
+    GiMutex() { pthread_mutex_init(&_mutex, NULL); }
+    ~GiMutex() { pthread_mutex_destroy(&_mutex); }
+    void lock() { pthread_mutex_lock(&_mutex); }
+    void unlock() { pthread_mutex_unlock(&_mutex); }
+private:
+    pthread_mutex_t _mutex;
+#endif
+    GiMutex(const GiMutex&);
+    void operator=(const GiMutex&);
+    
+public:
+    //! 在作用域内加锁
+    class Lock
+    {
+    public:
+        Lock(GiMutex& m) : _m(m) { _m.lock(); }
+        ~Lock() { _m.unlock(); }
+    private:
+        GiMutex&    _m;
+        Lock(const Lock&);
+        void operator=(const Lock&);
+    };
+};
+
+//! 自动复位的线程通知，一个线程等待，其他线程通知
+/*! 先通知后等待时等待立即返回，多次通知只唤醒一次。
+    \ingroup GRAPH_INTERFACE
+ */
+class GiSignal
+{
+public:
+#if defined(__WINDOWS__) || defined(WIN32)
+    GiSignal() { _handle = CreateEvent(NULL, FALSE, FALSE, NULL); }
+    ~GiSignal() { CloseHandle(_handle); }
+    
+    //! 发出通知，唤醒等待的线程
+    void signal() { SetEvent(_handle); }
+    
+    //! 等待通知，返回后通知复位
+    void wait() { WaitForSingleObject(_handle, INFINITE); }
+    
+private:
+    HANDLE          _handle;
+#else
+    GiSignal() : _signaled(false) {
+        pthread_mutex_init(&_mutex, NULL);
+        pthread_cond_init(&_cond, NULL);
+    }
+    ~GiSignal() {
+        pthread_cond_destroy(&_cond);
+        pthread_mutex_destroy(&_mutex);
+    }
+    
+    //! 发出通知，唤醒等待的线程
+    void signal() {
+        pthread_mutex_lock(&_mutex);
+        _signaled = true;
+        pthread_cond_signal(&_cond);
+        pthread_mutex_unlock(&_mutex);
+    }
+    
+    //! 等待通知，返回后通知复位
+    void wait() {
+        pthread_mutex_lock(&_mutex);
+        while (!_signaled)
+            pthread_cond_wait(&_cond, &_mutex);
+        _signaled = false;
+        pthread_mutex_unlock(&_mutex);
+    }
+    
+private:
+    pthread_mutex_t _mutex;
+    pthread_cond_t  _cond;
+    bool            _signaled;
+#endif
+    GiSignal(const GiSignal&);
+    void operator=(const GiSignal&);
+};
+
+//! 单生产者单消费者的无锁有界队列，生产者和消费者可分别在不同线程
+/*! T 为可复制的简单类型，N 为容量。
+    \ingroup GRAPH_INTERFACE
+ */
+template <typename T, int N>
+class GiRingQueue
+{
+public:
+    GiRingQueue() : _head(0), _tail(0) {}
+    
+    //! 返回队列中的元素个数
+    int size() const { return (int)(_tail - _head); }
+    
+    //! 返回队列是否已满
+    bool full() const { return size() >= N; }
+    
+    //! 在生产者线程中添加元素，队列满则返回false
+    bool push(const T& item) {
+        if (full())
+            return false;
+        _items[(unsigned long)_tail % N] = item;
+        giMemoryBarrier();                  // 先写元素再发布
+        giAtomicIncrement(&_tail);
+        return true;
+    }
+    
+    //! 在消费者线程中取出元素，队列空则返回false
+    bool pop(T& item) {
+        if (size() <= 0)
+            return false;
+        giMemoryBarrier();                  // 看到发布后再读元素
+        item = _items[(unsigned long)_head % N];
+        giAtomicIncrement(&_head);
+        return true;
+    }
+    
+private:
+    T               _items[N];
+    volatile long   _head;                  // 消费者的读位置
+    volatile long   _tail;                  // 生产者的写位置
+};
+
+#endif // SWIG
+#endif // TOUCHVG_GITHREAD_H_
@@ -39,6 +39,11 @@ public:
 
     //! 写数据到给定的文件
     bool save(FILE* fp, bool pretty = true);
+    
+    //! 将 storageForRead() 读入的全部内容写到另一个存取接口对象，末尾为数字的节点名拆出序号
+    /*! 只有颜色和标志位的"0x"字符串还原为无符号整数，数组含非数字元素时返回false
+    */
+    bool copyTo(MgStorage* dest);
 #endif
     
     //! 返回JSON内容
@@ -0,0 +1,43 @@
+﻿//! \file mgjsonwriter.h
+//! \brief 定义流式JSON输出类 MgJsonWriter
+// Copyright (c) 2004-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_CORE_JSONWRITER_H_
+#define TOUCHVG_CORE_JSONWRITER_H_
+
+#ifndef SWIG
+#include <cstdio>
+#endif
+struct MgStorage;
+
+//! 流式JSON输出类，写入时直接输出JSON文本，不构造文档树
+/*! 输出内容与 MgJsonStorage::save() 相同，内存占用只有一个输出缓冲区。
+    \ingroup CORE_STORAGE
+ */
+class MgJsonWriter
+{
+public:
+    MgJsonWriter();
+    ~MgJsonWriter();
+    
+#ifndef SWIG
+    //! 输出JSON文本的回调函数
+    typedef void (*WriteProc)(void* param, const char* data, int size);
+    
+    //! 返回存取接口对象以便开始写数据，JSON文本直接输出到给定的文件
+    MgStorage* storageForWrite(FILE* fp, bool pretty = true);
+    
+    //! 返回存取接口对象以便开始写数据，JSON文本分段输出到给定的回调函数
+    MgStorage* storageForWrite(WriteProc proc, void* param, bool pretty = true);
+#endif
+    
+    //! 输出缓冲区中剩余的内容，返回是否已完整写出根节点
+    bool finish();
+    
+private:
+    class Impl;
+    Impl* _impl;
+};
+
+#endif // TOUCHVG_CORE_JSONWRITER_H_
@@ -0,0 +1,69 @@
+﻿//! \file recordindex.h
+//! \brief 定义录制帧的索引文件类 MgRecordIndex
+// Copyright (c) 2013-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_RECORD_INDEX_H_
+#define TOUCHVG_RECORD_INDEX_H_
+
+#include <stdio.h>
+#include "mgmappedfile.h"
+
+//! 录制帧的索引文件类
+/*! 文件头为16字节，之后每帧一条定长记录(时刻, 标志, 关键帧)，第i条记录对应序号为i+1的帧文件。
+    关键帧为不晚于本帧的最近一个关键帧文件(N.vgk)的序号，0表示首帧文件 0.vg。
+    录制时只追加记录，读取时映射整个文件，按序号直接定位记录。
+ */
+class MgRecordIndex
+{
+public:
+    MgRecordIndex();
+    ~MgRecordIndex();
+    
+    //! 返回录制目录下的索引文件名
+    static const char* fileName() { return "records.idx"; }
+    
+    //! 创建索引文件以便写入记录，保留原文件的前 keepCount 条记录
+    bool create(const char* filename, int keepCount = 0);
+    
+    //! 返回是否已创建索引文件以便写入
+    bool isCreated() const { return _fp != NULL; }
+    
+    //! 写入序号为 index 的记录，通常是追加在末尾
+    bool write(int index, int tick, int flags, int keyframe);
+    
+    //! 将已写入的记录输出到文件
+    void flush();
+    
+    //! 打开索引文件以便读取记录
+    bool open(const char* filename);
+    
+    //! 关闭索引文件
+    void close();
+    
+    //! 返回打开的索引文件中的记录数
+    int getCount() const { return _count; }
+    
+    //! 返回指定序号的记录中的时刻
+    int getTick(int index) const { return readField(index, 0); }
+    
+    //! 返回指定序号的记录中的标志
+    int getFlags(int index) const { return readField(index, 1); }
+    
+    //! 返回指定序号的记录所用的关键帧序号
+    int getKeyframe(int index) const { return readField(index, 2); }
+    
+    //! 返回不晚于给定时刻的最后一条记录的序号，没有则为-1
+    int findFrame(int tick) const;
+    
+private:
+    int readField(int index, int field) const;
+    
+private:
+    FILE*           _fp;
+    MgMappedFile    _file;
+    int             _recordSize;
+    int             _count;
+};
+
+#endif // TOUCHVG_RECORD_INDEX_H_
@@ -0,0 +1,65 @@
+﻿//! \file recordpack.h
+//! \brief 定义录制帧的单文件容器类 MgRecordPack
+// Copyright (c) 2013-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_RECORD_PACK_H_
+#define TOUCHVG_RECORD_PACK_H_
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include "mgmappedfile.h"
+
+//! 录制帧的单文件容器类，代替录制目录下的多个帧文件
+/*! 文件头为16字节，之后为只追加的数据段，每段为段头(标识, 名称长度, 内容长度)、名称和内容。
+    文件末尾为目录(各段的名称、位置和长度)和结尾(目录位置, 段数, 标识)，读取时映射整个文件，
+    按名称直接得到内容地址。同名的段以后写的为准。目录损坏时从头扫描数据段恢复。
+ */
+class MgRecordPack
+{
+public:
+    MgRecordPack();
+    ~MgRecordPack();
+    
+    //! 返回录制目录下的容器文件名
+    static const char* fileName() { return "records.vgp"; }
+    
+    //! 创建或续写容器文件，保留已有的数据段
+    bool create(const char* filename);
+    
+    //! 返回是否已创建容器文件以便写入
+    bool isCreated() const { return _fp != NULL; }
+    
+    //! 追加一个数据段
+    bool write(const char* name, const void* data, int size);
+    
+    //! 写出目录，使读取者能看到已追加的数据段
+    void flush();
+    
+    //! 打开容器文件以便读取
+    bool open(const char* filename);
+    
+    //! 关闭容器文件，写入时先写出目录
+    void close();
+    
+    //! 返回数据段的个数
+    int getCount() const { return (int)_items.size(); }
+    
+    //! 返回给定名称的数据段的内容，不复制，文件关闭前有效
+    const unsigned char* find(const char* name, int& size) const;
+    
+private:
+    bool loadItems(const unsigned char* data, int size);
+    int scanItems(const unsigned char* data, int size);
+    
+private:
+    typedef std::map<std::string, std::pair<int, int> > Items;     // 名称 -> (位置, 长度)
+    FILE*           _fp;
+    MgMappedFile    _file;
+    Items           _items;
+    int             _dataEnd;           // 数据段的结尾，即目录位置
+    bool            _dirty;
+};
+
+#endif // TOUCHVG_RECORD_PACK_H_
@@ -12,6 +12,7 @@ class MgShapeDoc;
 class MgShapes;
 class MgShape;
 struct MgShapeFactory;
+struct MgStorage;
 
 class MgRecordShapes
 {
@@ -27,12 +28,22 @@ public:
                     MgShapes* dynShapes, const std::vector<MgShapes*>& extShapes);
     std::string getFileName(bool back = false, int index = -1) const;
     std::string getPath() const;
+    bool popWrittenFile(std::string& filename);
 #endif
     bool isLoading() const;
     void setLoading(bool loading);
     bool onResume(long ticks);
     void restore(int index, int count, int tick, long curTick);
     void stopRecordIndex();
+    void setMemoryBudget(int bytes, bool spillOnStop = false);
+    int getMemoryBytes() const;
+    bool setBinaryFormat(bool binary, float precision = 0.f);
+    bool setKeyframeInterval(int frames, int bytes);
+    bool setPackFile(bool packed);
+    static int packRecords(const char* path, bool removeFiles);
+    static bool convertFile(const char* srcfile, const char* destfile,
+                            bool binary, float precision = 0.f);
+    static int convertRecords(const char* path, bool binary, float precision = 0.f);
     
 #ifndef SWIG
     bool canUndo() const;
@@ -51,14 +62,30 @@ public:
     bool applyFirstFile(MgShapeFactory *factory, MgShapeDoc* doc, const char* filename);
     int applyRedoFile(MgShapeFactory *f, MgShapeDoc* doc, MgShapes* dyns, int index);
     int applyUndoFile(MgShapeFactory *f, MgShapeDoc* doc, MgShapes* dyns, int index, long curTick);
+    int seekTo(MgShapeFactory *f, MgShapeDoc* doc, MgShapes* dyns, int tick);
+    
+    bool startPrefetch(MgShapeFactory *f, MgShapeDoc* doc, int maxBytes = 8 * 1024 * 1024);
+    void stopPrefetch();
+    int getFramesAhead() const;
+    int getBytesAhead() const;
+    float getParseTime() const;
+    float getApplyTime() const;
 #ifndef SWIG
     static bool loadFrameIndex(std::string path, std::vector<int>& arr);
 #endif
 
 private:
+    bool writeStep(long tick, long changeCount, MgShapeDoc* doc, MgShapes* dynShapes);
+    static void writerProc(void* param);
+    static void prefetchProc(void* param);
     static int applyFile(int& tick, MgShapeFactory *f,
                          MgShapeDoc* doc, MgShapes* dyns, const char* fn,
                          long* changeCount = NULL, MgShape* lastShape = NULL);
+    static int applyStorage(int& tick, MgShapeFactory *f,
+                            MgShapeDoc* doc, MgShapes* dyns, MgStorage* s,
+                            long* changeCount, MgShape* lastShape);
+    int applyStep(bool back, int index, MgShapeFactory *f, MgShapeDoc* doc,
+                  MgShapes* dyns, long* changeCount = NULL, MgShape* lastShape = NULL);
     
 private:
     struct Impl;
@@ -266,6 +266,12 @@ public:
 
     //! 删除一个顶点
     virtual bool removePoint(int index);
+    
+    //! 用Douglas-Peucker算法化简顶点，返回去掉的顶点数
+    /*! \param tol 顶点到化简后折线的最大允许距离，模型坐标
+        \see mglnrel::simplifyLines
+    */
+    virtual int simplify(float tol);
 
     //! 返回边的最大序号
     int maxEdgeIndex() const;
@@ -332,9 +338,11 @@ public:
     virtual bool addPoint(const Point2d& pt);
     virtual bool insertPoint(int segment, const Point2d& pt);
     virtual bool removePoint(int index);
+    virtual int simplify(float tol);
     
     bool smooth(const Matrix2d& m2d, float tol);
     int smoothForPoints(int count, const Point2d* points, const Matrix2d& m2d, float tol);
+    bool setFittedKnots(int count, const Point2d* knots, const Vector2d* knotvs, const Matrix2d& d2m);
     void clearVectors();
 
 protected:
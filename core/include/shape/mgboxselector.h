@@ -0,0 +1,48 @@
+﻿//! \file mgboxselector.h
+//! \brief 定义框选图形的辅助类 MgBoxSelector
+// Copyright (c) 2004-2013, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_MGBOXSELECTOR_H_
+#define TOUCHVG_MGBOXSELECTOR_H_
+
+#include "mgshapes.h"
+#include <vector>
+
+//! 框选图形的辅助类，拖动选择框时增量更新选中的图形
+/*! 第一次框选时建立图形包络框的网格索引，此后只对包络框与前后两个选择框的差异区域相交的图形
+    重新判断是否选中，其余图形沿用上一次的结果。
+    \ingroup CORE_SHAPE
+*/
+class MgBoxSelector
+{
+public:
+    MgBoxSelector();
+    ~MgBoxSelector();
+    
+    //! 按新的选择框更新选中的图形，返回选中的图形是否有变化
+    /*! 图形列表有增删改时自动重建索引.
+        \param shapes 图形列表
+        \param box 选择框，模型坐标
+        \param intersect true 表示选择与框相交的图形，false 表示选择完全在框内的图形
+    */
+    bool update(const MgShapes* shapes, const Box2d& box, bool intersect);
+    
+    //! 得到选中的图形ID，按图形列表中的次序
+    void getSelection(std::vector<int>& ids) const;
+    
+    //! 得到选中的图形个数
+    int getSelectionCount() const;
+    
+    //! 结束框选，释放索引
+    void reset();
+    
+private:
+    MgBoxSelector(const MgBoxSelector&);
+    void operator=(const MgBoxSelector&);
+    
+    struct Impl;
+    Impl*   _impl;
+};
+
+#endif // TOUCHVG_MGBOXSELECTOR_H_
@@ -32,6 +32,12 @@ public:
     
     virtual bool isCurve() const { return true; }
     virtual void setOwner(MgShape* owner);
+    
+    //! 子图形增删改后由子图形列表调用，增量更新包络框并向上通知所在的复合图形
+    /*! \param sp 新增或改变后的子图形，删除子图形时为NULL
+        \param grown 是否只增加了图形或子图形范围只扩大了，此时包络框只需合并其范围
+     */
+    void childChanged(const MgShape* sp, bool grown);
 
 protected:
     MgComposite();
@@ -56,9 +62,21 @@ protected:
     bool _offset(const Vector2d& vec, int segment);
     bool _draw(int mode, GiGraphics& gs, const GiContext& ctx, int segment) const;
 
+    //! 建立子图形的包络框层次索引，子图形较少时不建立
+    void rebuildIndex();
+    
+    //! 子图形改变后丢弃索引，在下次查找时重建
+    void invalidateIndex();
+    
+    //! 查找范围与给定矩形框相交的子图形，按显示次序排列，需要时先重建索引，没有索引时返回false
+    bool findChildren(const Box2d& box, std::vector<const MgShape*>& shapes) const;
+
 protected:
+    struct Index;
     MgShape*    _owner;
     MgShapes*   _shapes;
+    mutable Index*  _index;             //!< 子图形的包络框层次索引，子图形改变后在查找时重建
+    mutable volatile long _indexDirty;  //!< 索引是否需要重建
 };
 
 //! 成组图形类
@@ -46,6 +46,9 @@ public:
     //! 返回是否为闭合填充图形
     virtual bool hasFillColor() const;
 
+    //! 返回图形的范围，延迟加载的图形不必加载几何数据
+    virtual Box2d getExtent() const;
+
     //! 显示图形
     /*!
         \param mode 绘图方式，0-正常显示，1-选中显示，2-拖动显示
@@ -7,6 +7,9 @@
 #define TOUCHVG_MGSHAPES_H_
 
 #include "mgshape.h"
+#ifndef SWIG
+#include <vector>
+#endif
 
 //! 图形列表类
 /*! \ingroup CORE_SHAPE
@@ -36,6 +39,14 @@ public:
     void freeIterator(void*& it) const;
     typedef bool (*Filter)(const MgShape*);
     int traverseByType(int type, void (*c)(const MgShape*, void*), void* d);
+    
+    //! 返回变动日志的当前位置，journalId 为日志标识，图形列表清空或重新加载后会改变
+    long getJournalPos(long& journalId) const;
+    
+    //! 得到从日志位置 pos 以来增删改过的图形ID(按变动先后，可能重复)
+    /*! 日志标识不符或已截断时返回false，此时需要比较全部图形。浅拷贝的图形列表带有原日志。
+     */
+    bool getChangedIDs(long journalId, long pos, std::vector<int>& ids) const;
 #endif
 
     int getShapeCount() const;
@@ -99,6 +110,10 @@ public:
     
     //! 移除一个图形
     bool removeShape(int sid);
+#ifndef SWIG
+    //! 移除多个图形，只遍历一次图形列表，返回移除的个数
+    int removeShapes(const int* ids, int count);
+#endif
 
     //! 将一个图形移到另一个图形列表
     bool moveShapeTo(int sid, MgShapes* dest);
@@ -106,6 +121,9 @@ public:
     //! 将所有图形复制到另一个图形列表
     void copyShapesTo(MgShapes* dest) const;
     
+    //! 将所有图形对象直接移到另一个图形列表，同ID同类型的图形替换原图形，返回移动的个数
+    int moveShapesTo(MgShapes* dest);
+    
     //! 移动图形到最后，以便显示在最前面
     bool bringToFront(int sid);
     
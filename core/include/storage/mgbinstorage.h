@@ -0,0 +1,82 @@
+﻿//! \file mgbinstorage.h
+//! \brief 定义二进制序列化类 MgBinStorage
+// Copyright (c) 2004-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_CORE_BINSTORAGE_H_
+#define TOUCHVG_CORE_BINSTORAGE_H_
+
+#ifndef SWIG
+#include <cstdio>
+#include <vector>
+#endif
+struct MgStorage;
+
+//! 二进制序列化类
+/*! 数据为紧凑的标记流，键名只保存一次，整数为变长编码，浮点数为小端字节序的原始值。
+    设置精度后坐标数组按精度量化并对同轴的前一坐标差分编码。
+    比 MgJsonStorage 更小且读写更快，适合撤销步骤和录制帧等数据。
+    \ingroup CORE_STORAGE
+ */
+class MgBinStorage
+{
+public:
+    MgBinStorage();
+    ~MgBinStorage();
+    
+    //! 给定二进制内容，返回存取接口对象以便开始读取，读取完成前内容须有效
+    MgStorage* storageForRead(const void* data, int size);
+    
+    //! 映射给定的文件后返回存取接口对象以便开始读取，直接读映射内容而不复制，文件不能映射时返回NULL
+    /*! \param filename 文件名
+        \param lazy 为true时图形延迟到需要时才加载，读完后仍保留映射内容，直到不再被延迟加载的图形引用；
+                    为false时由多个线程并行加载图形
+     */
+    MgStorage* storageForMapping(const char* filename, bool lazy = false);
+    
+    //! 返回存取接口对象以便开始写数据，写完可调用 getData() 或 save()
+    MgStorage* storageForWrite();
+    
+    //! 设置写入坐标数组(超过6个数)的量化精度，0表示原样保存
+    void setPrecision(float unit);
+    
+    //! 将 storageForRead() 读入的全部内容写到另一个存取接口对象
+    bool copyTo(MgStorage* dest);
+    
+#ifndef SWIG
+    //! 给定文件句柄，读入其全部内容后返回存取接口对象以便开始读取
+    MgStorage* storageForRead(FILE* fp);
+    
+    //! 写数据到给定的文件
+    bool save(FILE* fp);
+    
+    //! 返回已写入的二进制内容
+    const unsigned char* getData() const;
+    
+    //! 交换出已写入的二进制内容，避免复制
+    void swapData(std::vector<unsigned char>& data);
+    
+    //! 检查给定内容是否为本格式
+    static bool isBinary(const void* data, int size);
+    
+    //! 检查给定文件是否为本格式，不改变文件位置
+    static bool isBinaryFile(FILE* fp);
+#endif
+    
+    //! 返回已写入的二进制内容的字节数
+    int getSize() const;
+    
+    //! 清除内存资源
+    void clear();
+    
+    //! 返回 storageForRead() 中的解析错误，NULL表示没有错误
+    const char* getParseError();
+    
+private:
+    class Impl;
+    Impl* _impl;
+    
+    Impl* detach();
+};
+
+#endif // TOUCHVG_CORE_BINSTORAGE_H_
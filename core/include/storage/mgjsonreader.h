@@ -0,0 +1,45 @@
+﻿//! \file mgjsonreader.h
+//! \brief 定义流式JSON读取类 MgJsonReader
+// Copyright (c) 2004-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_CORE_JSONREADER_H_
+#define TOUCHVG_CORE_JSONREADER_H_
+
+#ifndef SWIG
+#include <cstdio>
+#endif
+struct MgStorage;
+
+//! 流式JSON读取类，边解析边读取，不构造整个文档树
+/*! 只保存当前各级节点中已扫描到的简单成员，子节点按需进入，跳过的子节点只记下位置，
+    按写入次序读取时内存占用与文件大小无关，前面的图形可在后面的图形解析前使用。
+    语法在读取中检查，遇到错误时后续节点读取失败且 MgStorage::isBroken() 为真，由读取方丢弃已读出的部分。
+    \ingroup CORE_STORAGE
+ */
+class MgJsonReader
+{
+public:
+    MgJsonReader();
+    ~MgJsonReader();
+    
+    //! 给定JSON内容，返回存取接口对象以便开始读取，读取完成前内容须有效
+    MgStorage* storageForRead(const char* content);
+    
+#ifndef SWIG
+    //! 给定以二进制方式打开的JSON文件句柄，返回存取接口对象以便开始读取，读取完成前文件须有效
+    MgStorage* storageForRead(FILE* fp);
+#endif
+    
+    //! 清除内存资源
+    void clear();
+    
+    //! 返回读取中的解析错误，NULL表示没有错误
+    const char* getParseError();
+    
+private:
+    class Impl;
+    Impl* _impl;
+};
+
+#endif // TOUCHVG_CORE_JSONREADER_H_
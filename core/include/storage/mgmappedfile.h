@@ -0,0 +1,47 @@
+﻿//! \file mgmappedfile.h
+//! \brief 定义只读内存映射文件类 MgMappedFile
+// Copyright (c) 2004-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_CORE_MAPPEDFILE_H_
+#define TOUCHVG_CORE_MAPPEDFILE_H_
+
+//! 只读内存映射文件类
+/*! 打开后整个文件映射到内存，按需由系统换页，适合随机访问大文件。
+    \ingroup CORE_STORAGE
+ */
+class MgMappedFile
+{
+public:
+    MgMappedFile();
+    ~MgMappedFile();
+    
+    //! 打开并映射文件，空文件也返回true
+    bool open(const char* filename);
+    
+    //! 取消映射并关闭文件
+    void close();
+    
+    //! 返回是否已打开
+    bool isOpen() const { return _opened; }
+    
+    //! 返回映射的内容，空文件为NULL
+    const unsigned char* data() const { return _data; }
+    
+    //! 返回文件的字节数
+    int size() const { return _size; }
+    
+    //! 用新写好的文件替换目标文件，目标文件可能正被映射，POSIX 下已映射的原内容仍有效
+    static bool replaceFile(const char* srcfile, const char* destfile);
+    
+private:
+    const unsigned char*    _data;
+    int                     _size;
+    bool                    _opened;
+    void*                   _handle[2];
+    
+    MgMappedFile(const MgMappedFile&);
+    void operator=(const MgMappedFile&);
+};
+
+#endif // TOUCHVG_CORE_MAPPEDFILE_H_
@@ -6,6 +6,8 @@
 #ifndef TOUCHVG_MGSTORAGE_H_
 #define TOUCHVG_MGSTORAGE_H_
 
+struct MgStorageSource;
+
 //! 图形存取接口
 /*! \ingroup CORE_STORAGE
     \interface MgStorage
@@ -51,6 +53,12 @@ struct MgStorage
     virtual int readString(const char* name, char* value, int count) = 0;
     //! 添加一个给定字段名称(常量)的浮点数数组
     virtual void writeFloatArray(const char* name, const float* values, int count) = 0;
+    //! 返回可在读取后重新进入节点的共享对象，不支持时返回NULL
+    virtual MgStorageSource* getSource() { return (MgStorageSource*)0; }
+    //! 返回正在读取的节点的位置，可传给 MgStorageSource::lockNode()，不支持时返回-1
+    virtual int tellNode() { return -1; }
+    //! 返回是否遇到内容语法错误而未能读完，边解析边读取时已读出的部分应丢弃
+    virtual bool isBroken() { return false; }
 #endif
 
     //! 给定字段名称(常量)，取出一个整数的值
@@ -64,4 +72,24 @@ struct MgStorage
     virtual bool setError(const char* errdesc) { return !errdesc; }
 };
 
+#ifndef SWIG
+//! 可重新进入节点读取的共享存取对象，用于延迟加载图形
+/*! 由 MgStorage::getSource() 得到，用 addRef() 和 release() 管理生存期，可在多个线程中使用
+    \ingroup CORE_STORAGE
+*/
+struct MgStorageSource
+{
+    virtual ~MgStorageSource() {}
+    virtual void addRef() = 0;
+    virtual void release() = 0;
+    
+    //! 返回是否应延迟到需要时才读取节点，否则应在加载时读取完
+    virtual bool isLazy() = 0;
+    //! 返回一个独立的存取接口，已进入给定位置的节点，多个线程可各自打开节点同时读取，失败时返回NULL
+    virtual MgStorage* openNode(int pos) = 0;
+    //! 释放 openNode() 返回的存取接口
+    virtual void closeNode(MgStorage* s) = 0;
+};
+#endif
+
 #endif // TOUCHVG_MGSTORAGE_H_
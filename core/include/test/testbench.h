@@ -0,0 +1,63 @@
+//! \file testbench.h
+//! \brief Define the benchmark class: TestBench.
+// Copyright (c) 2012-2013, https://github.com/rhcad/touchvg
+
+#ifndef TOUCHVG_TESTBENCH_H
+#define TOUCHVG_TESTBENCH_H
+
+//! The benchmarks and self checks of the core features.
+/*! Each function logs its result and returns it, so that the test application
+    of any platform can call them.
+    \ingroup GRAPH_INTERFACE
+ */
+struct TestBench {
+    //! Simulate dragging the magnifier across the main view.
+    /*! The magnifier shows the main view at 2x while its center moves to the bottom edge.
+        \param cached true if the canvas supplies the main view's cached bitmap.
+        \param frames The count of dragging frames.
+        \return Average drawing milliseconds of the magnifier per frame.
+     */
+    static float magnifierDrag(bool cached, int frames = 120);
+    
+    //! Load a JSON document of random shapes through MgJsonStorage.
+    /*! The shapes are read as shape1..shapeN under one node, so the time should
+        grow linearly with the count of shapes.
+        \param count The count of each kind of random shapes, 4*count shapes in all.
+        \return Milliseconds of parsing and loading the document, or -1 if any shape is not loaded.
+     */
+    static float jsonLoad(int count);
+    
+    //! Save random shapes as JSON and binary documents, and check that both load the same.
+    /*! The .vgb file is loaded normally and read-only (lazily), and each result
+        is compared with the shapes loaded from the .vg file.
+        \param filename The path without extension, ".vg" and ".vgb" are appended.
+        \return true if all the loaded documents have the same content.
+     */
+    static bool binaryRoundTrip(const char* filename);
+    
+    //! Drag a selection box over random shapes, comparing MgBoxSelector with the full scan.
+    /*! The box corner sweeps across the shapes so that the box both grows and shrinks.
+        \param count The count of each kind of random shapes, 4*count shapes in all.
+        \param intersect true to select the shapes touching the box, false for the shapes inside.
+        \param moves The count of dragging moves.
+        \return Average milliseconds of MgBoxSelector per move after the first move which builds
+                the index, or -1 if any selection differs.
+     */
+    static float boxSelect(int count, bool intersect, int moves = 100);
+    
+    //! Solve a random periodic tridiagonal system by mgcurv::cyclicTriEquations and gaussJordan.
+    /*! \param n The order of the system, the dense matrix of gaussJordan has n*n elements.
+        \return The max relative difference between the two solutions, or -1 if any solver fails.
+     */
+    static float cyclicTriEquations(int n);
+    
+    //! Compute the tangent vectors of closed cubic splines with random knots.
+    /*! Up to 512 knots the result is checked against the dense matrix solved by gaussJordan,
+        which cubicSplines used before.
+        \param n The count of knots.
+        \return Milliseconds of mgcurv::cubicSplines with cubicLoop, or -1 if it fails or differs.
+     */
+    static float closedSplines(int n);
+};
+
+#endif // TOUCHVG_TESTBENCH_H
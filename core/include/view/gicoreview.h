@@ -68,7 +68,9 @@ public:
     bool startRecord(const char* path, long doc,
                      bool forUndo, long curTick,
                      MgStringCallback* c = (MgStringCallback*)0);   //!< 开始录制图形，自动释放，在主线程用
-    void stopRecord(bool forUndo);                                  //!< 停止录制图形
+    void stopRecord(bool forUndo,
+                    MgStringCallback* c = (MgStringCallback*)0);   //!< 停止录制图形，写完剩余的帧后通知其文件名
+    int seekRecord(long doc, long shapes, int tick);                //!< 播放时跳到指定时刻的帧，传入播放项的后端文档和动态图形
     bool recordShapes(bool forUndo, long tick, long doc, long shapes); //!< 录制图形，自动释放
     bool recordShapes(bool forUndo, long tick, long doc,
                       long shapes, const mgvector<long>* exts,
@@ -79,6 +81,7 @@ public:
     bool onResume(long curTick);                                    //!< 继续
     bool restoreRecord(int type, const char* path, long doc, long changeCount,
                        int index, int count, int tick, long curTick);   //!< 恢复录制
+    bool setUndoMemoryBudget(int bytes, bool spillOnStop);          //!< 设置撤销步骤的内存上限，超出时写到文件，spillOnStop 为真时停止录制时写出全部步骤以便恢复录制
     
 // MgCoreView
 #ifndef SWIG
@@ -45,6 +45,13 @@ public:
     virtual void viewChanged(GiView* oldview) {}    //!< 当前视图改变的通知
     virtual void shapeDeleted(int sid) {}   //!< 删除图形的通知
     
+    //! 批量删除图形的通知，默认逐个调用 shapeDeleted
+    virtual void shapesDeleted(const mgvector<int>& ids) {
+        for (int i = 0; i < ids.count(); i++) {
+            shapeDeleted(ids.get(i));
+        }
+    }
+    
     //! 图形点击的通知，返回false继续显示上下文按钮
     virtual bool shapeClicked(int sid, int tag, float x, float y) { return false; }
 };
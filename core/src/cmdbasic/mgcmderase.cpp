@@ -84,6 +84,7 @@ bool MgCmdErase::longPress(const MgMotion* sender)
 bool MgCmdErase::touchBegan(const MgMotion* sender)
 {
     m_boxsel = true;
+    m_boxSelector.reset();
     sender->view->redraw();
     return true;
 }
@@ -98,14 +99,13 @@ bool MgCmdErase::isIntersectMode(const MgMotion*)
 bool MgCmdErase::touchMoved(const MgMotion* sender)
 {
     Box2d snap(sender->startPtM, sender->pointM);
-    MgShapeIterator it(m_boxsel ? sender->view->shapes() : NULL);
     
-    m_delIds.clear();
-    while (const MgShape* shape = it.getNext()) {
-        if (isIntersectMode(sender) ? shape->shapec()->hitTestBox(snap)
-            : snap.contains(shape->shapec()->getExtent())) {
-            m_delIds.push_back(shape->getID());
-        }
+    if (m_boxsel) {     // 只重新判断选择框变化处的图形
+        m_boxSelector.update(sender->view->shapes(), snap, isIntersectMode(sender));
+        m_boxSelector.getSelection(m_delIds);
+    }
+    else {
+        m_delIds.clear();
     }
     sender->view->redraw();
     
@@ -114,19 +114,8 @@ bool MgCmdErase::touchMoved(const MgMotion* sender)
 
 bool MgCmdErase::touchEnded(const MgMotion* sender)
 {
-    MgShapes* s = sender->view->shapes();
-    
-    if (!m_delIds.empty()
-        && sender->view->shapeWillDeleted(s->findShape(m_delIds.front()))) {
-        int count = 0;
-        std::vector<int>::iterator it = m_delIds.begin();
-        
-        for (; it != m_delIds.end(); ++it) {
-            const MgShape* shape = s->findShape(*it);
-            if (shape && sender->view->removeShape(shape)) {
-                count++;
-            }
-        }
+    if (!m_delIds.empty()) {
+        int count = sender->view->removeShapes(&m_delIds.front(), (int)m_delIds.size());
         if (count > 0) {
             sender->view->regenAll(true);
         }
@@ -134,6 +123,7 @@ bool MgCmdErase::touchEnded(const MgMotion* sender)
     
     m_delIds.clear();
     m_boxsel = false;
+    m_boxSelector.reset();
     sender->view->redraw();
     
     return true;
@@ -7,6 +7,7 @@
 #define TOUCHVG_CMD_ERASE_H_
 
 #include "mgcmd.h"
+#include "mgboxselector.h"
 #include <vector>
 
 //! 橡皮擦命令类
@@ -38,6 +39,7 @@ private:
     
     std::vector<int>     m_delIds;
     bool                    m_boxsel;
+    MgBoxSelector           m_boxSelector;
 };
 
 #endif // TOUCHVG_CMD_ERASE_H_
@@ -5,9 +5,18 @@
 #include "mgdrawfreelines.h"
 #include "mgshapet.h"
 #include "mgbasicsp.h"
+#include "mgstorage.h"
 
-bool MgCmdDrawFreeLines::initialize(const MgMotion* sender, MgStorage*)
+static const int kMaxSamples = 64;      // 一段折线最多跨过的采样点数
+
+// 可用参数 {"freelines":{"mindist":0.5,"tolerance":0.2}} 设置采样点过滤距离，单位为显示毫米
+bool MgCmdDrawFreeLines::initialize(const MgMotion* sender, MgStorage* s)
 {
+    if (s && s->readNode(Name(), -1, false)) {
+        m_minDist = s->readFloat("mindist", m_minDist);
+        m_tolerance = s->readFloat("tolerance", m_tolerance);
+        s->readNode(Name(), -1, true);
+    }
     return _initialize(MgShapeT<MgLines>::create, sender);
 }
 
@@ -16,6 +25,7 @@ bool MgCmdDrawFreeLines::backStep(const MgMotion* sender)
     if (m_step > 2) {                   // 去掉倒数第二个点，倒数第一点是临时动态点
         ((MgBaseLines*)dynshape()->shape())->removePoint(m_step - 1);
         dynshape()->shape()->update();
+        m_samples.clear();
     }
     return MgCommandDraw::backStep(sender);
 }
@@ -32,6 +42,7 @@ bool MgCmdDrawFreeLines::touchBegan(const MgMotion* sender)
     dynshape()->shape()->setPoint(0, sender->startPtM);
     dynshape()->shape()->setPoint(1, sender->pointM);
     dynshape()->shape()->update();
+    m_samples.clear();
 
     return MgCommandDraw::touchBegan(sender);
 }
@@ -54,13 +65,15 @@ bool MgCmdDrawFreeLines::touchMoved(const MgMotion* sender)
             lines->addPoint(sender->pointM);
     }
     if (!closed) {
-        dynshape()->shape()->setPoint(m_step, sender->pointM);
-        if (m_step > 0 && canAddPoint(sender, false)) {
+        if (m_step > 0 && canAddPoint(sender, false)) {     // 保留当前动态点为顶点
             m_step++;
+            m_samples.clear();
             if (m_step >= dynshape()->shape()->getPointCount()) {
                 ((MgBaseLines*)dynshape()->shape())->addPoint(sender->pointM);
             }
         }
+        dynshape()->shape()->setPoint(m_step, sender->pointM);
+        m_samples.push_back(sender->pointM);
     }
     dynshape()->shape()->update();
 
@@ -85,10 +98,17 @@ bool MgCmdDrawFreeLines::touchEnded(const MgMotion* sender)
             lines->addPoint(sender->pointM);
     }
     if (!closed) {
+        if (m_step > 0 && canAddPoint(sender, false)) {
+            m_step++;
+            if (m_step >= dynshape()->shape()->getPointCount()) {
+                lines->addPoint(sender->pointM);
+            }
+        }
         dynshape()->shape()->setPoint(m_step, sender->pointM);
         if (m_step > 0 && !canAddPoint(sender, true))
             lines->removePoint(m_step);
     }
+    m_samples.clear();
     dynshape()->shape()->update();
     
     if (m_step > 1) {
@@ -102,24 +122,30 @@ bool MgCmdDrawFreeLines::touchEnded(const MgMotion* sender)
     return MgCommandDraw::touchEnded(sender);
 }
 
-bool MgCmdDrawFreeLines::canAddPoint(const MgMotion* /*sender*/, bool /*ended*/)
+// 判断当前动态点(m_step)是否保留为顶点。
+// 结束时动态点为最后的采样点，只要与前一顶点不重合就保留；
+// 否则先按与前一顶点的距离过滤，再看前一顶点之后的采样点是否都靠近前一顶点到新采样点的线段，
+// 是则当前动态点可由新采样点代替，相当于对已确定的这段折线用Douglas-Peucker法化简
+bool MgCmdDrawFreeLines::canAddPoint(const MgMotion* sender, bool ended)
 {
-    /*float minDist = sender->displayMmToModel(3.f);
-    Point2d endPt  = dynshape()->shape()->getPoint(m_step - 1);
-    float distToEnd = endPt.distanceTo(sender->pointM);
-    float turnAngle = 90;
-    
-    if (m_step > 1)
-    {
-        Point2d lastPt = dynshape()->shape()->getPoint(m_step - 2);
-        turnAngle = (endPt - lastPt).angleTo(sender->pointM - endPt);
-        turnAngle = mgRad2Deg(fabsf(turnAngle));
-    }
+    Point2d endPt(dynshape()->shape()->getPoint(m_step - 1));
+    float distToEnd = endPt.distanceTo(dynshape()->shape()->getPoint(m_step));
+    float minDist = sender->displayMmToModel(m_minDist);
     
-    if (distToEnd < minDist * (ended ? 0.25 : 1))
+    if (ended)
+        return distToEnd >= minDist * 0.25f;
+    if (distToEnd < minDist)
         return false;
-    if (!ended && sin(turnAngle) * distToEnd < 5)
-        return false;*/
+    if (m_tolerance < _MGZERO || (int)m_samples.size() >= kMaxSamples)
+        return true;
+    
+    float tol = sender->displayMmToModel(m_tolerance);
+    Point2d nearpt;
+    
+    for (size_t i = 0; i < m_samples.size(); i++) {
+        if (mglnrel::ptToLine(endPt, sender->pointM, m_samples[i], nearpt) > tol)
+            return true;
+    }
     
-    return true;
+    return false;
 }
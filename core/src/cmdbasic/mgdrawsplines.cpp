@@ -62,6 +62,10 @@ bool MgCmdDrawSplines::touchBegan(const MgMotion* sender)
         if (!m_freehand)
             dynshape()->shape()->setPoint(1, pnt);
         dynshape()->shape()->update();
+        if (m_freehand) {
+            m_fitter.clear(sender->view->xform()->getWorldToDisplayY() * 0.5f);
+            addFitPoint(sender, pnt);
+        }
         
         return MgCommandDraw::touchBegan(sender);
     }
@@ -80,6 +84,7 @@ bool MgCmdDrawSplines::touchMoved(const MgMotion* sender)
     if (m_freehand) {
         if (canAddPoint(sender, false)) {
             lines->addPoint(pnt);
+            addFitPoint(sender, pnt);
             m_step++;
         }
     } else {
@@ -104,22 +109,14 @@ bool MgCmdDrawSplines::touchEnded(const MgMotion* sender)
     if (m_freehand) {
         if (lines->endPoint() != pnt) {
             lines->addPoint(pnt);
+            addFitPoint(sender, pnt);
             dynshape()->shape()->update();
         }
         
         Tol tol(sender->displayMmToModel(1.f));
         if (m_step > 0 && !dynshape()->shape()->getExtent().isEmpty(tol, false)) {
-            MgShape* newsp = addShape(sender);
-            if (newsp) {/*
-                m_step = 0;
-                sender->view->regenAppend(0);
-                newsp = newsp->cloneShape();
-                lines = (MgSplines*)newsp->shape();
-                lines->smooth(sender->view->xform()->modelToDisplay(),
-                              sender->view->xform()->getWorldToDisplayY() * 0.5f);
-                sender->view->shapes()->updateShape(newsp);
-                sender->view->regenAppend(newsp->getID())*/
-            }
+            smoothStroke(sender);
+            addShape(sender);
         }
         else {
             click(sender);  // add a point
@@ -207,6 +204,26 @@ bool MgCmdDrawSplines::canAddPoint(const MgMotion* sender, bool ended)
     return true;
 }
 
+void MgCmdDrawSplines::addFitPoint(const MgMotion* sender, const Point2d& pnt)
+{
+    m_fitter.addPoint(pnt * sender->view->xform()->modelToDisplay());
+}
+
+void MgCmdDrawSplines::smoothStroke(const MgMotion* sender)
+{
+    MgSplines* lines = (MgSplines*)dynshape()->shape();
+    const GiTransform* xf = sender->view->xform();
+    
+    // 拟合点与图形的点一致时只需拟合末尾未冻结的点，否则(例如回退过点)重新整体拟合
+    if (m_fitter.getPointCount() == lines->getPointCount() && m_fitter.end() > 1) {
+        lines->setFittedKnots(m_fitter.getKnotCount(), m_fitter.getKnots(),
+                              m_fitter.getKnotVectors(), xf->displayToModel());
+    } else {
+        lines->smooth(xf->modelToDisplay(), xf->getWorldToDisplayY() * 0.5f);
+    }
+    m_fitter.clear(0);
+}
+
 bool MgCmdDrawSplines::click(const MgMotion* sender)
 {
     if (m_freehand) {
@@ -120,6 +120,11 @@ private:
             (*it)->onShapeDeleted(sender, shape);
         }
     }
+    virtual void onShapesDeleted(const MgMotion* sender, int count, const MgShape* const* shapes) {
+        for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
+            (*it)->onShapesDeleted(sender, count, shapes);
+        }
+    }
     virtual bool onShapeCanRotated(const MgMotion* sender, const MgShape* shape) {
         for (Iterator it = _arr.begin(); it != _arr.end(); ++it) {
             if (!(*it)->onShapeCanRotated(sender, shape)) {
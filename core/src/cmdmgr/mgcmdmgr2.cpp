@@ -78,17 +78,8 @@ void MgCmdManagerImpl::eraseWnd(const MgMotion* sender)
         }
     }
     
-    if (!delIds.empty()
-        && sender->view->shapeWillDeleted(s->findShape(delIds.front()))) {
-        std::vector<int>::iterator i = delIds.begin();
-        int n = 0;
-        
-        for (; i != delIds.end(); ++i) {
-            const MgShape* shape = s->findShape(*i);
-            if (shape && sender->view->removeShape(shape)) {
-                n++;
-            }
-        }
+    if (!delIds.empty()) {
+        int n = sender->view->removeShapes(&delIds.front(), (int)delIds.size());
         if (n > 0)
             sender->view->regenAll(true);
     }
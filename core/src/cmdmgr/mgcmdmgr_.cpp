@@ -30,6 +30,7 @@ bool MgCmdManagerImpl::registerCommand(const char* name, MgCommand* (*creator)()
 }
 
 MgCmdManagerImpl::MgCmdManagerImpl() : _newShapeID(0), _subject(NULL), _snapShapeId(0)
+    , _snapIndex(NULL)
 {
     _snapType[0] = _snapType[1] = 0;
 }
@@ -37,6 +38,7 @@ MgCmdManagerImpl::MgCmdManagerImpl() : _newShapeID(0), _subject(NULL), _snapShap
 MgCmdManagerImpl::~MgCmdManagerImpl()
 {
     unloadCommands();
+    freeSnapIndex();
 }
 
 void MgCmdManagerImpl::unloadCommands()
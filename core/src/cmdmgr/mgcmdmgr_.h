@@ -13,6 +13,7 @@
 #include <string>
 
 class SnapItem;
+class SnapIndex;
 class CmdSubjectImpl;
 
 //! 命令管理器实现类
@@ -74,6 +75,7 @@ private:
 private:
     void eraseWnd(const MgMotion* sender);
     void checkResult(SnapItem arr[3]);
+    void freeSnapIndex();
     void freeSubject();
 
 private:
@@ -92,6 +94,7 @@ private:
     int             _snapShapeId;
     int             _snapHandle;
     int             _snapHandleSrc;
+    SnapIndex*      _snapIndex;
 };
 
 #endif // TOUCHVG_CMD_MANAGER_IMPL_H_
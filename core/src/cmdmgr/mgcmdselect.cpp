@@ -18,38 +18,145 @@
 #define ENABLE_DRAG_SELBOX
 #endif
 
+static inline unsigned hashSelId(int id)
+{
+    return (unsigned)id * 2654435761u;
+}
+
+bool MgSelectionIds::contains(int id) const
+{
+    if (_slots.empty() || 0 == id)
+        return false;
+    
+    unsigned mask = (unsigned)_slots.size() - 1;
+    for (unsigned i = hashSelId(id) & mask; _slots[i] != 0; i = (i + 1) & mask) {
+        if (_slots[i] == id)
+            return true;
+    }
+    return false;
+}
+
+bool MgSelectionIds::push_back(int id)
+{
+    if (0 == id || contains(id))
+        return false;
+    if ((_ids.size() + 1) * 2 > _slots.size())     // 装填因子不超过一半
+        rehash(_ids.size() + 1);
+    
+    unsigned mask = (unsigned)_slots.size() - 1;
+    unsigned i = hashSelId(id) & mask;
+    
+    while (_slots[i] != 0)
+        i = (i + 1) & mask;
+    _slots[i] = id;
+    _ids.push_back(id);
+    _stamp++;
+    
+    return true;
+}
+
+void MgSelectionIds::assign(const std::vector<int>& ids)
+{
+    clear();
+    rehash(ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
+        push_back(ids[i]);
+}
+
+void MgSelectionIds::clear()
+{
+    if (_slots.size() > 64) {
+        std::vector<int>().swap(_slots);
+    } else {
+        std::fill(_slots.begin(), _slots.end(), 0);
+    }
+    _ids.clear();
+    _stamp++;
+}
+
+void MgSelectionIds::rehash(size_t n)
+{
+    size_t size = 16;
+    while (size < n * 2)
+        size *= 2;
+    if (size <= _slots.size())
+        return;
+    
+    _slots.assign(size, 0);
+    unsigned mask = (unsigned)size - 1;
+    
+    for (size_t j = 0; j < _ids.size(); j++) {
+        unsigned i = hashSelId(_ids[j]) & mask;
+        while (_slots[i] != 0)
+            i = (i + 1) & mask;
+        _slots[i] = _ids[j];
+    }
+}
+
 int MgCmdSelect::getSelection(MgView* view, int count, const MgShape** shapes)
 {
-    int i, ret = 0;
-    int maxCount = (int)(m_clones.empty() ? m_selIds.size() : m_clones.size());
+    if (count < 1 || !shapes) {
+        return (int)(m_clones.empty() ? getSelectedShapes(view).size() : m_clones.size());
+    }
     
-    if (count < 1 || !shapes)
-        return maxCount;
+    int i, maxCount = 0;
+    const MgShape* const* span = getSelectionSpan(view, maxCount);
     
     for (i = maxCount; i < count; i++)
         shapes[i] = NULL;
     count = mgMin(count, maxCount);
     
-    if (m_clones.empty() && count > 0) {
-        for (i = 0; i < count; i++) {
-            const MgShape* shape = view->shapes()->findShape(m_selIds[i]);
-            if (shape)
-                shapes[ret++] = shape;
-        }
+    for (i = 0; i < count; i++) {
+        shapes[i] = span[i];
     }
-    else {
-        for (i = 0; i < count; i++) {
-            shapes[ret++] = m_clones[i];
+    
+    return count;
+}
+
+const MgShape* const* MgCmdSelect::getSelectionSpan(MgView* view, int& count)
+{
+    if (!m_clones.empty()) {
+        applyDragMatrix(view);
+        count = (int)m_clones.size();
+        return &m_clones.front();
+    }
+    
+    const std::vector<const MgShape*>& shapes = getSelectedShapes(view);
+    
+    count = (int)shapes.size();
+    return shapes.empty() ? NULL : &shapes.front();
+}
+
+const std::vector<const MgShape*>& MgCmdSelect::getSelectedShapes(MgView* view)
+{
+    const MgShapes* s = view->shapes();
+    long journalId = 0;
+    long pos = s ? s->getJournalPos(journalId) : 0;
+    
+    if (m_selOwner != s || m_selStamp != m_selIds.stamp()
+        || m_selJournal[0] != journalId || m_selJournal[1] != pos) {
+        m_selOwner = s;
+        m_selStamp = m_selIds.stamp();
+        m_selJournal[0] = journalId;
+        m_selJournal[1] = pos;
+        
+        m_selShapes.clear();
+        m_selShapes.reserve(m_selIds.size());
+        for (sel_iterator it = m_selIds.begin(); it != m_selIds.end(); ++it) {
+            const MgShape* shape = s ? s->findShape(*it) : NULL;
+            if (shape)
+                m_selShapes.push_back(shape);
         }
     }
     
-    return ret;
+    return m_selShapes;
 }
 
 int MgCmdSelect::getSelectionForChange(MgView* view, int count, MgShape** shapes)
 {
     if (m_clones.empty())
         cloneShapes(view);
+    applyDragMatrix(view);
     
     int i, ret = 0;
     int maxCount = (int)m_clones.size();
@@ -77,9 +184,11 @@ bool MgCmdSelect::dynamicChangeEnded(MgView* view, bool apply)
     return applyCloneShapes(view, apply);
 }
 
-MgCmdSelect::MgCmdSelect() : MgCommand(Name())
+MgCmdSelect::MgCmdSelect() : MgCommand(Name()), m_selOwner(NULL), m_selStamp(-1)
+    , m_matPending(false), m_matMoved(false), m_clonesMoved(false)
 {
     m_editMode = true;
+    m_selJournal[0] = m_selJournal[1] = 0;
 }
 
 bool MgCmdSelect::cancel(const MgMotion* sender)
@@ -144,7 +253,7 @@ bool MgCmdSelect::backStep(const MgMotion* sender)
 
 bool MgCmdSelect::draw(const MgMotion* sender, GiGraphics* gs)
 {
-    std::vector<const MgShape*> selection;
+    const std::vector<const MgShape*>& selection = getSelectedShapes(sender->view);
     const std::vector<const MgShape*>& shapes = (m_clones.empty() ? selection :
                                                  (std::vector<const MgShape*>&)m_clones);
     std::vector<const MgShape*>::const_iterator it;
@@ -156,12 +265,6 @@ bool MgCmdSelect::draw(const MgMotion* sender, GiGraphics* gs)
     bool rorate = (!isEditMode(sender->view)
         && m_boxHandle >= 8 && m_boxHandle < 12);
     
-    // 从 m_selIds 得到临时图形数组 selection
-    for (sel_iterator its = m_selIds.begin(); its != m_selIds.end(); ++its) {
-        const MgShape* shape = getShape(*its, sender);
-        if (shape)
-            selection.push_back(shape);
-    }
     if (selection.empty() && !m_selIds.empty()) {   // 意外情况导致m_selIds部分ID无效
         m_selIds.clear();
         sender->view->selectionChanged();
@@ -184,7 +287,17 @@ bool MgCmdSelect::draw(const MgMotion* sender, GiGraphics* gs)
     // 外部动态改变图形属性时，或拖动时
     if (!m_showSel || !m_clones.empty()) {
         for (it = shapes.begin(); it != shapes.end(); ++it) {
-            (*it)->draw(m_showSel ? 2 : 0, *gs, NULL, -1);  // 原样显示
+            if (!m_matPending || (*it)->shapec()->getFlag(kMgShapeLocked))
+                (*it)->draw(m_showSel ? 2 : 0, *gs, NULL, -1);  // 原样显示
+        }
+        if (m_matPending && !m_clones.empty()) {    // 整体拖动时临时图形不变，只变换显示
+            Matrix2d m2w(gs->xf().modelToWorld());
+            GiSaveModelTransform xf(&gs->xf(), m2w.inverse() * m_dragMat * m2w);
+            
+            for (it = shapes.begin(); it != shapes.end(); ++it) {
+                if (!(*it)->shapec()->getFlag(kMgShapeLocked))
+                    (*it)->draw(m_showSel ? 2 : 0, *gs, NULL, -1);
+            }
         }
     }
     else if (m_clones.empty()) {                    // 蓝色显示选中的图形
@@ -306,16 +419,6 @@ bool MgCmdSelect::draw(const MgMotion* sender, GiGraphics* gs)
     return true;
 }
 
-MgCmdSelect::sel_iterator MgCmdSelect::getSelectedPostion(const MgShape* shape)
-{
-    sel_iterator it = m_selIds.end();
-    if (shape) {
-        it = std::find_if(m_selIds.begin(), m_selIds.end(),
-                          std::bind2nd(std::equal_to<int>(), shape->getID()));
-    }
-    return it;
-}
-
 const MgShape* MgCmdSelect::getShape(int id, const MgMotion* sender) const
 {
     return sender->view->shapes()->findShape(id);
@@ -323,12 +426,13 @@ const MgShape* MgCmdSelect::getShape(int id, const MgMotion* sender) const
 
 const MgShape* MgCmdSelect::getShape(const MgMotion* sender)
 {
+    applyDragMatrix(sender->view);
     return m_clones.empty() ? getShape(m_id, sender) : m_clones.front();
 }
 
 bool MgCmdSelect::isSelected(const MgShape* shape)
 {
-    return getSelectedPostion(shape) != m_selIds.end();
+    return shape && m_selIds.contains(shape->getID());
 }
 
 const MgShape* MgCmdSelect::hitTestAll(const MgMotion* sender, MgHitResult& res)
@@ -568,6 +672,7 @@ bool MgCmdSelect::touchBegan(const MgMotion* sender)
     
     if (m_clones.empty()) {
         m_boxsel = true;
+        m_boxSelector.reset();
     }
     m_boxHandle = 99;
     
@@ -600,11 +705,10 @@ Box2d MgCmdSelect::getBoundingBox(const MgMotion* sender)
 {
     Box2d selbox;
     
-    for (size_t i = 0; i < m_selIds.size(); i++) {
-        const MgShape* shape = getShape(m_selIds[i], sender);
-        if (shape) {
-            selbox.unionWith(shape->shapec()->getExtent());
-        }
+    const std::vector<const MgShape*>& shapes = getSelectedShapes(sender->view);
+    
+    for (size_t i = 0; i < shapes.size(); i++) {
+        selbox.unionWith(shapes[i]->shapec()->getExtent());
     }
 
     float minDist = sender->view->xform()->displayToModel(8, true);
@@ -710,11 +814,11 @@ bool MgCmdSelect::isDragRectCorner(const MgMotion* sender, Matrix2d& mat)
     return m_boxHandle < 10;
 }
 
-static bool moveIntoLimits(MgBaseShape* shape, const MgMotion* sender)
+static bool offsetIntoLimits(const Box2d& extent, const MgMotion* sender, Vector2d& vec)
 {
     Box2d limits(sender->view->xform()->getWorldLimits()
                  * sender->view->xform()->worldToModel());
-    Box2d rect(shape->getExtent());
+    Box2d rect(extent);
     bool outside = false;
     
     limits.normalize();
@@ -735,14 +839,109 @@ static bool moveIntoLimits(MgBaseShape* shape, const MgMotion* sender)
         outside = true;
     }
     
+    vec = rect.center() - extent.center();
+    
+    return outside;
+}
+
+static bool moveIntoLimits(MgBaseShape* shape, const MgMotion* sender)
+{
+    Vector2d vec;
+    bool outside = offsetIntoLimits(shape->getExtent(), sender, vec);
+    
     if (outside) {
-        shape->offset(rect.center() - shape->getExtent().center(), -1);
+        shape->offset(vec, -1);
         shape->update();
     }
     
     return outside;
 }
 
+bool MgCmdSelect::canDragByMatrix(const MgMotion* sender, bool dragCorner)
+{
+    if (m_clones.size() < 2 || m_insertPt || m_rotateHandle > 0
+        || (m_handleIndex > 0 && isEditMode(sender->view))) {
+        return false;
+    }
+    if (dragCorner) {                                   // 非编辑状态下放缩时图形固定大小只平移，
+        return isEditMode(sender->view);                // 与矩阵显示的效果不同
+    }
+    if (m_hit.segment < 0) {
+        return true;
+    }
+    if (isEditMode(sender->view)) {                     // 可能只拖动某一段
+        return false;
+    }
+    for (size_t i = 0; i < m_clones.size(); i++) {
+        if (m_editMode && m_clones[i]->shapec()->isKindOf(kMgShapeComposite))
+            return false;
+    }
+    return true;
+}
+
+Matrix2d MgCmdSelect::snapDragMatrix(const MgMotion* sender, const Point2d& pointM)
+{
+    size_t i = 0;
+    while (i + 1 < m_clones.size() && m_clones[i]->getID() != m_id)
+        i++;
+    
+    MgBaseShape* shape = m_clones[i]->shape();
+    const MgShape* basesp = getShape(m_clones[i]->getID(), sender);
+    Vector2d vec(pointM - m_ptStart);
+    
+    if (basesp && !shape->getFlag(kMgShapeLocked)) {    // 只用拖动的图形捕捉
+        shape->offset(vec, -1);
+        shape->update();
+        vec += snapPoint(sender, m_clones[i]) - pointM;
+        shape->copy(*basesp->shapec());                 // 捕捉后恢复原始位置
+    }
+    
+    return Matrix2d::translation(vec);
+}
+
+void MgCmdSelect::resetMovedClones(const MgMotion* sender)
+{
+    if (m_clonesMoved) {
+        m_clonesMoved = false;
+        for (size_t i = 0; i < m_clones.size(); i++) {
+            const MgShape* basesp = getShape(m_clones[i]->getID(), sender);
+            if (basesp && !m_clones[i]->shapec()->getFlag(kMgShapeLocked))
+                m_clones[i]->shape()->copy(*basesp->shapec());
+        }
+    }
+}
+
+void MgCmdSelect::applyDragMatrix(MgView* view)
+{
+    if (!m_matPending || m_clones.empty())
+        return;
+    m_matPending = false;
+    m_clonesMoved = true;
+    
+    for (size_t i = 0; i < m_clones.size(); i++) {
+        MgBaseShape* shape = m_clones[i]->shape();
+        if (shape->getFlag(kMgShapeLocked))
+            continue;
+        
+        bool oldFixedLength = shape->getFlag(kMgFixedLength);
+        bool oldFixedSize = shape->getFlag(kMgFixedSize);
+        
+        if (!isEditMode(view)) {
+            shape->setFlag(kMgFixedLength, true);
+            shape->setFlag(kMgFixedSize, true);
+        }
+        shape->transform(m_dragMat);
+        shape->update();
+        if (!isEditMode(view)) {
+            shape->setFlag(kMgFixedLength, oldFixedLength);
+            shape->setFlag(kMgFixedSize, oldFixedSize);
+        }
+        if (m_matMoved) {
+            view->shapeMoved(m_clones[i], -1);          // 变换后再通知一次最终位置
+        }
+    }
+}
+
 bool MgCmdSelect::touchMoved(const MgMotion* sender)
 {
     Point2d pointM(sender->pointM);
@@ -760,6 +959,33 @@ bool MgCmdSelect::touchMoved(const MgMotion* sender)
         }
     }
     
+    if (canDragByMatrix(sender, dragCorner)) {         // 整体拖动多个图形时只改变换矩阵
+        resetMovedClones(sender);
+        m_matMoved = !dragCorner;
+        m_dragMat = dragCorner ? mat : snapDragMatrix(sender, pointM);
+        
+        Box2d extent;
+        Vector2d vec;
+        for (size_t i = 0; i < m_clones.size(); i++) {
+            if (!m_clones[i]->shapec()->getFlag(kMgShapeLocked))
+                extent.unionWith(m_clones[i]->shapec()->getExtent());
+        }
+        if (offsetIntoLimits(extent * m_dragMat, sender, vec)) {   // 限制图形在视图范围内
+            m_dragMat *= Matrix2d::translation(vec);
+        }
+        m_matPending = true;
+        
+        for (size_t i = 0; m_matMoved && i < m_clones.size(); i++) {
+            if (!m_clones[i]->shapec()->getFlag(kMgShapeLocked))
+                sender->view->shapeMoved(m_clones[i], -1);  // 每帧通知，图形坐标待松开时才变换
+        }
+        sender->view->redraw();
+        sender->view->dynamicChanged();
+        return true;
+    }
+    m_matPending = false;
+    m_clonesMoved = true;
+    
     Vector2d minsnap(1e8f, 1e8f);
     int snapindex = -1;
     
@@ -850,18 +1076,13 @@ bool MgCmdSelect::touchMoved(const MgMotion* sender)
     
     if (m_clones.empty() && m_boxsel) {    // 没有选中图形时就滑动多选
         Box2d snap(sender->startPtM, sender->pointM);
-        MgShapeIterator it(sender->view->shapes());
         
-        m_selIds.clear();
-        m_id = 0;
+        m_boxSelector.update(sender->view->shapes(), snap, isIntersectMode(sender));
+        std::vector<int> ids;
+        m_boxSelector.getSelection(ids);                // 只重新判断选择框变化处的图形
+        m_selIds.assign(ids);
+        m_id = m_selIds.empty() ? 0 : m_selIds.back();
         m_hit.segment = -1;
-        while (const MgShape* shape = it.getNext()) {
-            if (isIntersectMode(sender) ? shape->shapec()->hitTestBox(snap)
-                : snap.contains(shape->shapec()->getExtent())) {
-                m_selIds.push_back(shape->getID());
-                m_id = shape->getID();
-            }
-        }
         sender->view->redraw();
     }
     
@@ -904,13 +1125,14 @@ bool MgCmdSelect::touchEnded(const MgMotion* sender)
     }
     if (m_boxsel) {
         m_boxsel = false;
+        m_boxSelector.reset();
         if (!m_selIds.empty())
             sender->view->selectionChanged();
     }
     if (!m_selIds.empty()) {
         CmdSubject* subject = sender->view->getCmdSubject();
         subject->onSelectTouchEnded(sender, m_id, handleIndexSrc, shapeid, handleIndex,
-                                    (int)m_selIds.size(), &m_selIds.front());
+                                    (int)m_selIds.size(), m_selIds.address());
     }
     
     return sender->switchGesture || longPress(sender);
@@ -918,6 +1140,8 @@ bool MgCmdSelect::touchEnded(const MgMotion* sender)
 
 void MgCmdSelect::cloneShapes(MgView* view)
 {
+    m_matPending = false;
+    m_clonesMoved = false;
     for (std::vector<MgShape*>::iterator it = m_clones.begin();
          it != m_clones.end(); ++it) {
         (*it)->release();
@@ -940,6 +1164,7 @@ bool MgCmdSelect::applyCloneShapes(MgView* view, bool apply, bool addNewShapes)
     const bool cloned = !m_clones.empty();
     size_t i;
     
+    applyDragMatrix(view);
     if (apply) {
         apply = false;
         for (i = 0; i < m_clones.size() && !apply; i++) {
@@ -1063,27 +1288,17 @@ bool MgCmdSelect::selectAll(const MgMotion* sender)
 
 bool MgCmdSelect::deleteSelection(const MgMotion* sender)
 {
-    const MgShape* shape = (m_selIds.empty() ? NULL
-                            : sender->view->shapes()->findShape(m_selIds.front()));
     int count = 0;
     
-    if (shape && sender->view->shapeWillDeleted(shape)) {
+    if (!m_selIds.empty()) {                    // 逐个检查能否删除
         applyCloneShapes(sender->view, false);
-
-        for (sel_iterator it = m_selIds.begin(); it != m_selIds.end(); ++it) {
-            shape = sender->view->shapes()->findShape(*it);
-            if (shape && sender->view->removeShape(shape)) {
-                count++;
-            }
-        }
-        
+        count = sender->view->removeShapes(m_selIds.address(), (int)m_selIds.size());
+    }
+    if (count > 0) {                            // 都不能删除时保留选择
         m_selIds.clear();
         m_id = 0;
         m_handleIndex = 0;
         m_rotateHandle = 0;
-    }
-    
-    if (count > 0) {
         sender->view->regenAll(true);
         sender->view->selectionChanged();
     }
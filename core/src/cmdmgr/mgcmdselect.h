@@ -8,8 +8,44 @@
 
 #include "mgcmd.h"
 #include "mgselect.h"
+#include "mgboxselector.h"
 #include <vector>
 
+class MgShapes;
+
+//! 选中图形的ID集合，保持选中顺序，用开放定址散列表快速判断是否已选中
+/*! \ingroup CORE_COMMAND
+*/
+class MgSelectionIds
+{
+public:
+    typedef std::vector<int>::const_iterator const_iterator;
+    
+    MgSelectionIds() : _stamp(0) {}
+    
+    size_t size() const { return _ids.size(); }
+    bool empty() const { return _ids.empty(); }
+    int front() const { return _ids.front(); }
+    int back() const { return _ids.back(); }
+    int operator[](size_t i) const { return _ids[i]; }
+    const_iterator begin() const { return _ids.begin(); }
+    const_iterator end() const { return _ids.end(); }
+    const int* address() const { return _ids.empty() ? (const int*)0 : &_ids.front(); }
+    int stamp() const { return _stamp; }            //!< 每次改变后递增
+    
+    bool contains(int id) const;                    //!< 是否已选中，O(1)
+    bool push_back(int id);                         //!< 追加ID，已选中则忽略
+    void assign(const std::vector<int>& ids);       //!< 按顺序重设选中的ID
+    void clear();
+    
+private:
+    void rehash(size_t n);
+    
+    std::vector<int>    _ids;                       // 按选中顺序的ID
+    std::vector<int>    _slots;                     // 散列表，0表示空位
+    int                 _stamp;
+};
+
 //! 选择命令类
 /*! \ingroup CORE_COMMAND
 */
@@ -44,6 +80,7 @@ public:
     virtual bool overturnPolygon(const MgMotion* sender);
     virtual Box2d getBoundingBox(const MgMotion* sender);
     virtual bool isSelectedByType(MgView* view, int type);
+    virtual const MgShape* const* getSelectionSpan(MgView* view, int& count);
     
 private:
     MgCmdSelect();
@@ -71,9 +108,9 @@ private:
     bool isIntersectMode(const MgMotion* sender);
     Point2d snapPoint(const MgMotion* sender, const MgShape* shape);
     
-    typedef std::vector<int>::iterator sel_iterator;
-    sel_iterator getSelectedPostion(const MgShape* shape);
+    typedef MgSelectionIds::const_iterator sel_iterator;
     bool isSelected(const MgShape* shape);
+    const std::vector<const MgShape*>& getSelectedShapes(MgView* view);
     const MgShape* getShape(int id, const MgMotion* sender) const;
     bool isDragRectCorner(const MgMotion* sender, Matrix2d& mat);
     bool isCloneDrag(const MgMotion* sender);
@@ -81,9 +118,17 @@ private:
     bool applyCloneShapes(MgView* view, bool apply, bool addNewShapes = false);
     bool canTransform(const MgShape* shape, const MgMotion* sender);
     bool canRotate(const MgShape* shape, const MgMotion* sender);
+    bool canDragByMatrix(const MgMotion* sender, bool dragCorner);
+    Matrix2d snapDragMatrix(const MgMotion* sender, const Point2d& pointM);
+    void resetMovedClones(const MgMotion* sender);
+    void applyDragMatrix(MgView* view);
     
 private:
-    std::vector<int>        m_selIds;           // 选中的图形的ID
+    MgSelectionIds          m_selIds;           // 选中的图形的ID
+    std::vector<const MgShape*> m_selShapes;    // m_selIds 对应的图形，缓存
+    const MgShapes*         m_selOwner;         // m_selShapes 所在的图形列表
+    long                    m_selJournal[2];    // m_selShapes 对应的图形列表变动日志位置
+    int                     m_selStamp;         // m_selShapes 对应的 m_selIds.stamp()
     std::vector<MgShape*>   m_clones;           // 选中图形的复制对象
     int                     m_id;               // 选中图形的ID
     MgHitResult             m_hit;              // 点中结果
@@ -96,7 +141,12 @@ private:
     bool                    m_insertPt;         // 是否可插入新点
     bool                    m_showSel;          // 是否亮显选中的图形
     bool                    m_boxsel;           // 是否开始框选
+    MgBoxSelector           m_boxSelector;      // 增量框选
     bool                    m_dragging;         // 是否正在拖动
+    Matrix2d                m_dragMat;          // 整体拖动多个图形的变换矩阵，绘制时施加
+    bool                    m_matPending;       // m_dragMat 是否还未应用到临时图形
+    bool                    m_matMoved;         // m_dragMat 是否为整体平移
+    bool                    m_clonesMoved;      // 临时图形是否已应用了拖动变换
 };
 
 #endif // TOUCHVG_CMD_SELECT_H_
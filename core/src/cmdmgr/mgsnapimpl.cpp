@@ -4,6 +4,7 @@
 
 #include "mgcmdmgr_.h"
 #include "mggrid.h"
+#include <algorithm>
 
 class SnapItem {
 public:
@@ -205,32 +206,279 @@ static void snapGrid(const MgMotion*, const Point2d& orignPt,
     }
 }
 
-static void snapPoints(const MgMotion* sender, const Point2d& orignPt,
-                       const MgShape* shape, int ignoreHandle,
-                       const int* ignoreids, SnapItem arr[3], Point2d* matchpt)
+//! 可捕捉图形的网格索引，在一次拖动过程中缓存静止图形的控制点和包络框
+class SnapIndex {
+public:
+    struct Shape {
+        const MgShape*  sp;
+        Box2d           extent;         // 图形的包络框
+        bool            inWnd;          // 与显示窗口相交时才捕捉其控制点
+    };
+    std::vector<Shape>  shapes;         // 可捕捉的图形，保持图形列表中的次序
+    
+    SnapIndex() : _owner(NULL), _journalId(0), _journalPos(0), _count(0), _cell(0) {}
+    
+    //! 在图形列表、显示窗口、忽略图形或手势变化后重建索引
+    void update(const MgMotion* sender, const int* ignoreids, float cell) {
+        if (!isValid(sender, ignoreids, cell)) {
+            build(sender, ignoreids, cell);
+        }
+    }
+    //! 使索引失效，下次捕捉时重建
+    void invalidate() { _owner = NULL; }
+    
+    //! 查找控制点在 box 内的图形，添加图形序号到 orders
+    void queryHandles(const Box2d& box, std::vector<int>& orders) const {
+        findCells(_handles, _cell, box, true, orders);
+    }
+    //! 查找包络框与 box 相交的图形，添加图形序号到 orders
+    void queryExtents(const Box2d& box, std::vector<int>& orders) const;
+    
+private:
+    struct Entry {
+        unsigned    key;                // 网格号
+        int         order;              // 图形在 shapes 中的序号
+        Point2d     pt;                 // 控制点坐标
+        bool operator<(const Entry& e) const { return key < e.key; }
+    };
+    enum { kExtentCellScale = 4,        // 包络框网格相对于控制点网格的倍数
+           kMaxCells = 16 };            // 包络框最多登记的网格数
+    
+    bool isValid(const MgMotion* sender, const int* ignoreids, float cell) const;
+    void build(const MgMotion* sender, const int* ignoreids, float cell);
+    void addHandles(int order, const MgBaseShape* shape);
+    void addExtent(int order, const Box2d& extent);
+    void findCells(const std::vector<Entry>& entries, float cell, const Box2d& box,
+                   bool inBox, std::vector<int>& orders) const;
+    
+    static int cellIndex(float v, float cell) {
+        float i = floorf(v / cell);
+        return i < -32767.f ? -32767 : i > 32767.f ? 32767 : (int)i;
+    }
+    static unsigned cellKey(int ix, int iy) {
+        return ((unsigned)(ix + 0x8000) << 16) | (unsigned)(iy + 0x8000);
+    }
+    
+private:
+    std::vector<Entry>  _handles;       // 控制点所在的网格，按网格号排序
+    std::vector<Entry>  _extents;       // 包络框覆盖的网格，按网格号排序
+    std::vector<int>    _largeShapes;   // 覆盖网格太多的图形
+    std::vector<int>    _ignoreids;
+    const MgShapes*     _owner;
+    long                _journalId;
+    long                _journalPos;
+    int                 _count;
+    float               _cell;          // 控制点的网格宽度
+    Box2d               _wndbox;
+    Point2d             _startPt;       // 手势起始点，新手势开始时重建索引
+};
+
+bool SnapIndex::isValid(const MgMotion* sender, const int* ignoreids, float cell) const
 {
-    Box2d snapbox(orignPt, 2 * arr[0].dist, 0);         // 捕捉容差框
+    const MgShapes* owner = sender->view->shapes();
+    long journalId = 0;
+    long pos = owner ? owner->getJournalPos(journalId) : 0;
+    
+    if (!owner || owner != _owner || journalId != _journalId || pos != _journalPos
+        || owner->getShapeCount() != _count || cell != _cell
+        || sender->startPtM != _startPt
+        || sender->view->xform()->getWndRectM() != _wndbox) {
+        return false;
+    }
+    
+    size_t t = 0;
+    for (; ignoreids[t] != 0; t++) {
+        if (t >= _ignoreids.size() || ignoreids[t] != _ignoreids[t])
+            return false;
+    }
+    return t == _ignoreids.size();
+}
+
+void SnapIndex::build(const MgMotion* sender, const int* ignoreids, float cell)
+{
+    const MgShapes* owner = sender->view->shapes();
     GiTransform* xf = sender->view->xform();
-    Box2d wndbox(xf->getWndRectM());
-    MgShapeIterator it(sender->view->shapes());
+    float minsize = xf->displayToModel(2, true);
+    MgShapeIterator it(owner);
+    
+    shapes.clear();
+    _handles.clear();
+    _extents.clear();
+    _largeShapes.clear();
+    _ignoreids.clear();
+    for (int t = 0; ignoreids[t] != 0; t++) {
+        _ignoreids.push_back(ignoreids[t]);
+    }
+    _owner = owner;
+    _journalPos = owner ? owner->getJournalPos(_journalId) : 0;
+    _count = owner ? owner->getShapeCount() : 0;
+    _cell = cell;
+    _wndbox = xf->getWndRectM();
+    _startPt = sender->startPtM;
     
     while (const MgShape* sp = it.getNext()) {
         if (skipShape(ignoreids, sp)) {
             continue;
         }
-        Box2d extent(sp->shapec()->getExtent());
-        if (extent.width() < xf->displayToModel(2, true)
-            && extent.height() < xf->displayToModel(2, true)) { // 图形太小就跳过
+        Shape s;
+        s.sp = sp;
+        s.extent = sp->getExtent();
+        if (s.extent.width() < minsize && s.extent.height() < minsize) {   // 图形太小就跳过
+            continue;
+        }
+        s.inWnd = s.extent.isIntersect(_wndbox);
+        shapes.push_back(s);
+        
+        int order = (int)shapes.size() - 1;
+        addExtent(order, s.extent);
+        if (s.inWnd) {
+            addHandles(order, sp->shapec());
+        }
+    }
+    std::sort(_handles.begin(), _handles.end());
+    std::sort(_extents.begin(), _extents.end());
+}
+
+void SnapIndex::addHandles(int order, const MgBaseShape* shape)
+{
+    int n = shape->getHandleCount();
+    bool curve = shape->isKindOf(MgSplines::Type());
+    Entry e;
+    
+    e.order = order;
+    for (int i = 0; i < n; i++) {                       // 与 snapHandle 中捕捉的控制点相同
+        if ((curve && ((i > 0 && i + 1 < n) || shape->isClosed()))
+            || shape->getHandleType(i) >= kMgHandleOutside) {
             continue;
         }
-        if (extent.isIntersect(wndbox)
-            && !snapHandle(sender, orignPt, shape, ignoreHandle, sp, arr[0], matchpt)) {
-            if (extent.isIntersect(snapbox)) {
-                snapNear(sender, orignPt, shape, ignoreHandle, sp, arr[0], matchpt);
+        e.pt = shape->getHandlePoint(i);
+        e.key = cellKey(cellIndex(e.pt.x, _cell), cellIndex(e.pt.y, _cell));
+        _handles.push_back(e);
+    }
+}
+
+void SnapIndex::addExtent(int order, const Box2d& extent)
+{
+    float cell = _cell * kExtentCellScale;
+    int x1 = cellIndex(extent.xmin, cell), x2 = cellIndex(extent.xmax, cell);
+    int y1 = cellIndex(extent.ymin, cell), y2 = cellIndex(extent.ymax, cell);
+    
+    if (x2 - x1 >= kMaxCells || y2 - y1 >= kMaxCells
+        || (x2 - x1 + 1) * (y2 - y1 + 1) > kMaxCells) {
+        _largeShapes.push_back(order);                  // 大图形每次都作为候选
+        return;
+    }
+    
+    Entry e;
+    e.order = order;
+    for (int x = x1; x <= x2; x++) {
+        for (int y = y1; y <= y2; y++) {
+            e.key = cellKey(x, y);
+            _extents.push_back(e);
+        }
+    }
+}
+
+void SnapIndex::findCells(const std::vector<Entry>& entries, float cell, const Box2d& box,
+                          bool inBox, std::vector<int>& orders) const
+{
+    int x1 = cellIndex(box.xmin, cell), x2 = cellIndex(box.xmax, cell);
+    int y1 = cellIndex(box.ymin, cell), y2 = cellIndex(box.ymax, cell);
+    Entry lo;
+    
+    for (int x = x1; x <= x2; x++) {                    // 同一列的网格号是连续的
+        lo.key = cellKey(x, y1);
+        unsigned hikey = cellKey(x, y2);
+        std::vector<Entry>::const_iterator it = std::lower_bound(entries.begin(), entries.end(), lo);
+        
+        for (; it != entries.end() && it->key <= hikey; ++it) {
+            if (!inBox || box.contains(it->pt)) {
+                orders.push_back(it->order);
             }
         }
-        if (extent.isIntersect(snapbox)) {
-            snapGrid(sender, orignPt, shape, ignoreHandle, sp, arr, matchpt);
+    }
+}
+
+void SnapIndex::queryExtents(const Box2d& box, std::vector<int>& orders) const
+{
+    size_t n = orders.size();
+    
+    findCells(_extents, _cell * kExtentCellScale, box, false, orders);
+    orders.insert(orders.end(), _largeShapes.begin(), _largeShapes.end());
+    
+    for (size_t i = n; i < orders.size(); ) {
+        if (shapes[orders[i]].extent.isIntersect(box)) {
+            i++;
+        }
+        else {
+            orders[i] = orders.back();
+            orders.pop_back();
+        }
+    }
+}
+
+static void snapShape(const MgMotion* sender, const Point2d& orignPt,
+                      const MgShape* shape, int ignoreHandle, const SnapIndex::Shape& s,
+                      const Box2d& snapbox, SnapItem arr[3], Point2d* matchpt)
+{
+    if (s.inWnd
+        && !snapHandle(sender, orignPt, shape, ignoreHandle, s.sp, arr[0], matchpt)) {
+        if (s.extent.isIntersect(snapbox)) {
+            snapNear(sender, orignPt, shape, ignoreHandle, s.sp, arr[0], matchpt);
+        }
+    }
+    if (s.extent.isIntersect(snapbox)) {
+        snapGrid(sender, orignPt, shape, ignoreHandle, s.sp, arr, matchpt);
+    }
+}
+
+static void queryHandles(const SnapIndex& index, const Point2d& orignPt,
+                         const MgShape* shape, int ignoreHandle, bool moving,
+                         float radius, std::vector<int>& orders)
+{
+    float size = 2 * radius + 4 * _MGZERO;
+    
+    index.queryHandles(Box2d(orignPt, size, 0), orders);    // 触点附近的控制点
+    
+    int d = moving ? shape->shapec()->getHandleCount() - 1 : -1;
+    for (; d >= 0; d--) {                               // 批量查询移动图形各顶点附近的控制点
+        if (d != ignoreHandle && !shape->shapec()->isHandleFixed(d)) {
+            index.queryHandles(Box2d(shape->shapec()->getHandlePoint(d), size, 0), orders);
+        }
+    }
+}
+
+static void snapPoints(const MgMotion* sender, const Point2d& orignPt,
+                       const MgShape* shape, int ignoreHandle, const int* ignoreids,
+                       SnapIndex& index, SnapItem arr[3], Point2d* matchpt)
+{
+    Box2d snapbox(orignPt, 2 * arr[0].dist, 0);         // 捕捉容差框
+    float nearTol = sender->displayMmToModel(4.f);      // 近似点捕捉后放宽的容差
+    float radius = arr[0].dist + nearTol;               // 控制点的查询半径
+    std::vector<int> orders, more;
+    
+    index.update(sender, ignoreids, 2 * radius);
+    queryHandles(index, orignPt, shape, ignoreHandle, !!matchpt, radius, orders);
+    index.queryExtents(snapbox, orders);                // 可近似捕捉或网格捕捉的图形
+    
+    std::sort(orders.begin(), orders.end());            // 按图形次序捕捉，结果与逐个比较时相同
+    orders.erase(std::unique(orders.begin(), orders.end()), orders.end());
+    
+    for (size_t i = 0; i < orders.size(); i++) {
+        int order = orders[i];
+        
+        snapShape(sender, orignPt, shape, ignoreHandle, index.shapes[order],
+                  snapbox, arr, matchpt);
+        if (arr[0].dist > radius) {                     // 容差超出了查询半径，补充后续的候选图形
+            radius = arr[0].dist + nearTol;
+            more.clear();
+            queryHandles(index, orignPt, shape, ignoreHandle, !!matchpt, radius, more);
+            for (size_t j = 0; j < more.size(); j++) {
+                if (more[j] > order)
+                    orders.push_back(more[j]);
+            }
+            std::sort(orders.begin() + i + 1, orders.end());
+            orders.erase(std::unique(orders.begin() + i + 1, orders.end()), orders.end());
         }
     }
 }
@@ -264,7 +512,10 @@ Point2d MgCmdManagerImpl::snapPoint(const MgMotion* sender, const Point2d& orign
     bool matchpt = (shape && shape->getID() != 0    // 拖动整个图形
                     && (hotHandle < 0 || (ignoreHandle >= 0 && ignoreHandle != hotHandle)));
     
-    snapPoints(sender, orignPt, shape, ignoreHandle, ignoreids,
+    if (!_snapIndex) {
+        _snapIndex = new SnapIndex();
+    }
+    snapPoints(sender, orignPt, shape, ignoreHandle, ignoreids, *_snapIndex,
                arr, matchpt ? &pnt : NULL);         // 在所有图形中捕捉
     checkResult(arr);
     
@@ -321,8 +572,17 @@ bool MgCmdManagerImpl::getSnappedHandle(int& shapeid, int& handleIndex, int& han
     return shapeid != 0;
 }
 
+void MgCmdManagerImpl::freeSnapIndex()
+{
+    delete _snapIndex;
+    _snapIndex = NULL;
+}
+
 void MgCmdManagerImpl::clearSnap(const MgMotion* sender)
 {
+    if (_snapIndex) {
+        _snapIndex->invalidate();           // 图形可能在拖动结束后改变
+    }
     if (_snapType[0] || _snapType[1]) {
         _snapType[0] = 0;
         _snapType[1] = 0;
@@ -8,7 +8,7 @@
     TouchVG modifications Copyright (c) 2014 Zhang Yungui
  */
 
-#include "mgpnt.h"
+#include "mgcurv.h"
 #include "mgdblpt.h"
 
 typedef struct {
@@ -23,7 +23,7 @@ typedef struct {
 } PtArr;
 
 // Forward declarations
-typedef void        (*FitCubicCallback)(void* data, const Point2d curve[4]);
+typedef void        (*FitCubicCallback)(void* data, const Point2d curve[4], int last);
 void                FitCurve(FitCubicCallback fc, void* data, const Point2d *d, int nPts, float error);
 static  void        FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first,
                              int last, point_t tHat1, point_t tHat2, double error);
@@ -58,6 +58,103 @@ void FitCurve(FitCubicCallback fc, void* data, const Point2d *d, int nPts, float
     FitCubic(fc, data, arr, 0, nPts - 1, tHat1, tHat2, error);
 }
 
+/*
+ *  MgCurveFitter :
+ *      Fit digitized points while they arrive. Curves ending before the
+ *      last point are frozen, so only the open tail is fitted again.
+ *      kFitStep: New points between two fits of the tail
+ *      kMaxTail: Points of the tail to split at even if one curve fits them
+ */
+static const int kFitStep = 16;
+static const int kMaxTail = 256;
+
+void MgCurveFitter::clear(float tol)
+{
+    _pts.clear();
+    _knots.clear();
+    _knotvs.clear();
+    _indices.clear();
+    _tol = tol;
+    _start = 0;
+    _fixed = 0;
+    _fitted = 0;
+}
+
+void MgCurveFitter::addPoint(const Point2d& pt)
+{
+    _pts.push_back(pt);
+    if ((int)_pts.size() - _fitted >= kFitStep && _pts.size() > 2) {
+        fitTail(false);
+        _fitted = (int)_pts.size();
+    }
+}
+
+int MgCurveFitter::end()
+{
+    if (_pts.size() < 3) {
+        _knots.clear();
+        _knotvs.clear();
+        _indices.clear();
+        _fixed = 0;
+        return 0;
+    }
+    fitTail(true);
+    _fitted = (int)_pts.size();
+    return getKnotCount();
+}
+
+void MgCurveFitter::appendCurve(void* data, const Point2d curve[4], int last)
+{
+    MgCurveFitter* p = (MgCurveFitter*)data;
+    
+    if (p->_knots.empty()) {
+        p->_knots.push_back(curve[0]);
+        p->_knotvs.push_back(curve[1] - curve[0]);
+        p->_indices.push_back(0);
+    }
+    p->_knots.push_back(curve[3]);
+    p->_knotvs.push_back(curve[3] - curve[2]);
+    p->_indices.push_back(last);
+}
+
+void MgCurveFitter::fitTail(bool ended)
+{
+    int last = (int)_pts.size() - 1;
+    
+    fitRange(last, false);
+    
+    if (!ended && getKnotCount() - 1 > mgMax(_fixed, 1)) {    // Freeze all but the last curve
+        _fixed = getKnotCount() - 1;
+        _start = _indices[_fixed - 1];
+    }
+    if (!ended && last - _start > kMaxTail) {   // Split a long tail which one curve still fits
+        int mid = _start + kMaxTail / 2;
+        
+        fitRange(mid, true);
+        _fixed = getKnotCount();
+        _start = mid;
+    }
+}
+
+void MgCurveFitter::fitRange(int last, bool split)
+{
+    PtArr   d;
+    point_t tHat1, tHat2, tHatCenter;
+    
+    d.d = &_pts.front();
+    tHat2 = split ? ComputeCenterTangent(d, last) : ComputeRightTangent(d, last);
+    if (_fixed > 0) {       // Continue the frozen curve as the batch fit does at a split point
+        tHatCenter = ComputeCenterTangent(d, _start);
+        tHat1 = point_t(-tHatCenter.x, -tHatCenter.y);
+    } else {
+        tHat1 = ComputeLeftTangent(d, _start);
+    }
+    _knots.resize(_fixed);
+    _knotvs.resize(_fixed);
+    _indices.resize(_fixed);
+    FitCubic(appendCurve, this, d, _start, last, tHat1, tHat2, _tol);
+}
+
 
 /*
  *  FitCubic :
@@ -92,7 +189,7 @@ static void FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first,
         bezCurve.set(3, d[last]);
         bezCurve.set(1, bezCurve[0] + tHat1.scaledVector(dist));
         bezCurve.set(2, bezCurve[3] + tHat2.scaledVector(dist));
-        (*fc)(data, bezCurve.pts);
+        (*fc)(data, bezCurve.pts, last);
         return;
     }
 
@@ -104,7 +201,7 @@ static void FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first,
     maxError = ComputeMaxError(d, first, last, bezCurve, u, splitPoint);
     if (maxError < error) {
         delete[] u;
-        (*fc)(data, bezCurve.pts);
+        (*fc)(data, bezCurve.pts, last);
         return;
     }
 
@@ -117,7 +214,7 @@ static void FitCubic(FitCubicCallback fc, void* data, const PtArr &d, int first,
             if (maxError < error) {
                 delete[] u;
                 delete[] uPrime;
-                (*fc)(data, bezCurve.pts);
+                (*fc)(data, bezCurve.pts, last);
                 return;
             }
             delete[] u;
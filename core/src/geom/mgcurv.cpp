@@ -517,6 +517,65 @@ bool mgcurv::triEquations(
     return true;
 }
 
+bool mgcurv::cyclicTriEquations(
+    int n, float *a, float *b, float *c, Vector2d *vs)
+{
+    if (!a || !b || !c || !vs || n < 2 || mgIsZero(b[0]))
+        return false;
+    
+    // A = A' + u * v^T, u = (gamma, 0, ..., 0, alpha), v = (1, 0, ..., 0, beta/gamma)
+    float alpha = c[n-1], beta = a[n-1], gamma = -b[0];
+    float* z = new float[n];        // A' * z = u
+    float w, f;
+    Vector2d fv;
+    int i;
+    
+    b[0] -= gamma;
+    b[n-1] -= alpha * beta / gamma;
+    
+    w = 1 / b[0];
+    vs[0].x = vs[0].x * w;
+    vs[0].y = vs[0].y * w;
+    z[0] = gamma * w;
+    
+    for (i = 0; i <= n-2; i++)
+    {
+        b[i] = c[i] * w;
+        w = b[i+1] - a[i] * b[i];
+        if (mgIsZero(w)) {
+            delete[] z;
+            return false;
+        }
+        w = 1 / w;
+        vs[i+1].x = (vs[i+1].x - a[i] * vs[i].x) * w;
+        vs[i+1].y = (vs[i+1].y - a[i] * vs[i].y) * w;
+        z[i+1] = ((i+1 == n-1 ? alpha : 0.f) - a[i] * z[i]) * w;
+    }
+    
+    for (i = n-2; i >= 0; i--)
+    {
+        vs[i].x -= b[i] * vs[i+1].x;
+        vs[i].y -= b[i] * vs[i+1].y;
+        z[i] -= b[i] * z[i+1];
+    }
+    
+    f = 1 + z[0] + beta * z[n-1] / gamma;
+    if (mgIsZero(f)) {
+        delete[] z;
+        return false;
+    }
+    fv.x = (vs[0].x + beta * vs[n-1].x / gamma) / f;
+    fv.y = (vs[0].y + beta * vs[n-1].y / gamma) / f;
+    for (i = 0; i < n; i++)
+    {
+        vs[i].x -= z[i] * fv.x;
+        vs[i].y -= z[i] * fv.y;
+    }
+    delete[] z;
+    
+    return true;
+}
+
 bool mgcurv::gaussJordan(int n, float *mat, Vector2d *vs)
 {
     int i, j, k, m;
@@ -581,19 +640,21 @@ bool mgcurv::gaussJordan(int n, float *mat, Vector2d *vs)
 }
 
 static bool CalcCubicClosed(
-    int n, float* a, Vector2d* vecs, const Point2d* knots)
+    int n, const Point2d* knots, 
+    float* a, float* b, float* c, Vector2d* vecs)
 {
     int i, n1 = n - 1;
-
-    for (i = n*n - 1; i >= 0; i--)
-        a[i] = 0.f;
     
-    a[n1] = 1.0;
-    a[0]  = 4.0;
-    a[1]  = 1.0;
-    a[n1*n+n1 - 1] = 1.0;
-    a[n1*n+n1]   = 4.0;
-    a[n1*n+0]    = 1.0;
+    for (i = 0; i < n; i++)
+    {
+        a[i] = 1.0;
+        b[i] = 4.0;
+        c[i] = 1.0;
+    }
+    if (n == 2) {                   // 两个型值点时首末行不再重复计入角元素
+        a[n1] = 0.0;
+        c[n1] = 0.0;
+    }
     vecs[0].x  = 3 * (knots[1].x-knots[n1].x);
     vecs[0].y  = 3 * (knots[1].y-knots[n1].y);
     vecs[n1].x = 3 * (knots[0].x-knots[n1 - 1].x);
@@ -601,14 +662,11 @@ static bool CalcCubicClosed(
     
     for (i = 1; i < n1; i++)
     {
-        a[i*n+i-1] = 1.0;
-        a[i*n+i]   = 4.0;
-        a[i*n+i+1] = 1.0;
         vecs[i].x = 3 * (knots[i+1].x-knots[i-1].x);
         vecs[i].y = 3 * (knots[i+1].y-knots[i-1].y);
     }
     
-    return mgcurv::gaussJordan(n, a, vecs);
+    return mgcurv::cyclicTriEquations(n, a, b, c, vecs);
 }
 
 static bool CalcCubicUnclosed(
@@ -678,10 +736,11 @@ bool mgcurv::cubicSplines(
     if (!knots || !knotvs || n < 2)
         return false;
     
-    if ((flag & cubicLoop) && n <= 512)    // 闭合
+    if (flag & cubicLoop)               // 闭合
     {
-        float* a = new float[n * n];
-        ret = a && CalcCubicClosed(n, a, knotvs, knots);
+        float* a = new float[n * 3];
+        ret = a && CalcCubicClosed(n, knots, 
+            a, a+n, a+2*n, knotvs);
         delete[] a;
     }
     else
@@ -815,8 +874,9 @@ static bool CalcClampedVecs(
     int i;
     float w, ds, d1, d2;
 
-    ds = sigma * hp[0];
-    d1 = sigma * coshf(ds) / sinhf(ds) - 1.f / hp[0];
+    i = closed ? n1 - 1 : 0;        // 闭合时首点与末点相接
+    ds = sigma * hp[i];
+    d1 = sigma * coshf(ds) / sinhf(ds) - 1.f / hp[i];
     for (i = 0; i < n1; i++)
     {
         ds = sigma * hp[i];
@@ -826,10 +886,15 @@ static bool CalcClampedVecs(
         b[i] = d1 + d2;
         d1 = d2;
     }
-    if (closed)
-        b[n1] = d1;
-    else
-        b[n1] = d1 + d1;
+    if (closed)                     // 末点即首点，求解前n1个点的周期方程组
+    {
+        vecs[0] = vecs[n1];
+        if (!mgcurv::cyclicTriEquations(n1, a, b, c, vecs))
+            return false;
+        vecs[n1] = vecs[0];
+        return true;
+    }
+    b[n1] = d1 + d1;
     
     w = b[0];
     vecs[0].x /= w;
@@ -927,7 +992,7 @@ void mgcurv::fitClampedSpline(
     fitpt.y = (knotvs[i].y * s1 + knotvs[i+1].y * s2) *s3 + ty1*(hp[i] - t) + ty2*t;
 }
 
-typedef void (*FitCubicCallback)(void* data, const Point2d curve[4]);
+typedef void (*FitCubicCallback)(void* data, const Point2d curve[4], int last);
 extern  void FitCurve(FitCubicCallback fc, void* data, const Point2d *d, int nPts, float error);
 
 struct FitCurveHelper {
@@ -936,7 +1001,7 @@ struct FitCurveHelper {
     Point2d* knots;
     Vector2d* knotvs;
     
-    static void append(void* data, const Point2d curve[4]) {
+    static void append(void* data, const Point2d curve[4], int) {
         FitCurveHelper* p = (FitCurveHelper*)data;
         
         if (p->index + 1 < p->knotCount) {
@@ -449,3 +449,56 @@ bool mglnrel::isConvex(int count, const Point2d* vs, bool* pACW)
         *pACW = z0;
     return true;
 }
+
+int mglnrel::simplifyLines(int count, Point2d* points, float tol)
+{
+    if (count < 3 || !points)
+        return count;
+    
+    bool* keep = new bool[count];
+    int* stack = new int[count * 2];    // 待化简的首末点序号对
+    int top = 0, first, last, index, i, n;
+    float dist, maxdist;
+    Point2d nearpt;
+    
+    for (i = 1; i < count - 1; i++)
+        keep[i] = false;
+    keep[0] = keep[count - 1] = true;
+    stack[top++] = 0;
+    stack[top++] = count - 1;
+    
+    while (top > 0)
+    {
+        last = stack[--top];
+        first = stack[--top];
+        maxdist = 0;
+        index = first;
+        for (i = first + 1; i < last; i++)
+        {
+            dist = ptToLine(points[first], points[last], points[i], nearpt);
+            if (dist > maxdist)
+            {
+                maxdist = dist;
+                index = i;
+            }
+        }
+        if (maxdist > tol)              // 在最远点处分为两段
+        {
+            keep[index] = true;
+            stack[top++] = first;
+            stack[top++] = index;
+            stack[top++] = index;
+            stack[top++] = last;
+        }
+    }
+    
+    for (i = n = 0; i < count; i++)
+    {
+        if (keep[i])
+            points[n++] = points[i];
+    }
+    delete[] keep;
+    delete[] stack;
+    
+    return n;
+}
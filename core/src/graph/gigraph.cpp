@@ -78,6 +78,7 @@ bool GiGraphics::beginPaint(GiCanvas* canvas, const RECT_2D& clipBox)
     m_impl->rectDrawMaxM = xf().getWndRectM();
     m_impl->rectDrawW = m_impl->rectDrawM * xf().modelToWorld();
     m_impl->rectDrawMaxW = m_impl->rectDrawMaxM * xf().modelToWorld();
+    m_impl->rectZoomTimes = xf().getZoomTimes();
     
     return true;
 }
@@ -117,6 +118,7 @@ GiCanvas* GiGraphics::getCanvas()
 
 Box2d GiGraphics::getClipModel() const
 {
+    m_impl->checkModelTransform();
     return m_impl->rectDrawM;
 }
 
@@ -144,6 +146,7 @@ bool GiGraphics::setClipBox(const RECT_2D& rc)
             rect.get(m_impl->clipBox);
             m_impl->rectDraw.set(Box2d(rc));
             m_impl->rectDraw.inflate(GiGraphicsImpl::CLIP_INFLATE);
+            m_impl->checkModelTransform();
             m_impl->rectDrawM = m_impl->rectDraw * xf().displayToModel();
             m_impl->rectDrawW = m_impl->rectDrawM * xf().modelToWorld();
             SafeCall(m_impl->canvas, clipRect(m_impl->clipBox.left, m_impl->clipBox.top,
@@ -169,6 +172,7 @@ bool GiGraphics::setClipWorld(const Box2d& rectWorld)
                 box.get(m_impl->clipBox);
                 m_impl->rectDraw = box;
                 m_impl->rectDraw.inflate(GiGraphicsImpl::CLIP_INFLATE);
+                m_impl->checkModelTransform();
                 m_impl->rectDrawM = m_impl->rectDraw * xf().displayToModel();
                 m_impl->rectDrawW = m_impl->rectDrawM * xf().modelToWorld();
                 SafeCall(m_impl->canvas, clipRect(m_impl->clipBox.left, m_impl->clipBox.top,
@@ -275,13 +279,17 @@ static inline const Matrix2d& S2D(const GiTransform& xf, bool modelUnit)
     return modelUnit ? xf.modelToDisplay() : xf.worldToDisplay();
 }
 
-static inline const Box2d& DRAW_RECT(const GiGraphicsImpl* p, bool modelUnit)
+static inline const Box2d& DRAW_RECT(GiGraphicsImpl* p, bool modelUnit)
 {
+    if (modelUnit)
+        p->checkModelTransform();
     return modelUnit ? p->rectDrawM : p->rectDrawW;
 }
 
-static inline const Box2d& DRAW_MAXR(const GiGraphicsImpl* p, bool modelUnit)
+static inline const Box2d& DRAW_MAXR(GiGraphicsImpl* p, bool modelUnit)
 {
+    if (modelUnit)
+        p->checkModelTransform();
     return modelUnit ? p->rectDrawMaxM : p->rectDrawMaxW;
 }
 
@@ -24,6 +24,7 @@ public:
     float       minPenWidth;        //!< 最小像素线宽
 
     long        lastZoomTimes;      //!< 记下的放缩结果改变次数
+    long        rectZoomTimes;      //!< 模型坐标剪裁矩形对应的放缩结果改变次数
     volatile long   stopping;       //!< 是否需要停止绘图
     bool        isPrint;            //!< 是否打印或打印预览
     int         drawColors;         //!< 绘图DC颜色数
@@ -45,6 +46,7 @@ public:
         bkcolor = GiColor::White();
         maxPenWidth = 100;
         minPenWidth = 1;
+        rectZoomTimes = 0;
     }
 
     ~GiGraphicsImpl()
@@ -64,6 +66,16 @@ public:
         }
     }
 
+    //! 绘图中改变了模型变换后(例如用 GiSaveModelTransform)，更新模型坐标的剪裁矩形
+    void checkModelTransform()
+    {
+        if (rectZoomTimes != xform->getZoomTimes()) {
+            rectZoomTimes = xform->getZoomTimes();
+            rectDrawM = rectDraw * xform->displayToModel();
+            rectDrawMaxM = xform->getWndRectM();
+        }
+    }
+
 private:
     GiGraphicsImpl();
     void operator=(const GiGraphicsImpl&);
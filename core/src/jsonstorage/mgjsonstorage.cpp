@@ -1,6 +1,9 @@
 ﻿#include "mgjsonstorage.h"
 #include "mgstorage.h"
 #include <vector>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
 #include "mglog.h"
 
 #if !defined(_MSC_VER) || _MSC_VER > 1200
@@ -24,11 +27,13 @@ public:
     const char* getError() { return _err ? _err : _doc.GetParseError(); }
     FileStream& createStream(FILE* fp);
     bool save(FILE* fp, bool pretty);
+    bool copyTo(MgStorage* dest);
     
 private:
     bool readNode(const char* name, int index, bool ended);
     bool writeNode(const char* name, int index, bool ended);
     bool setError(const char* err);
+    Value* findChild(Value& parent, const char* name, SizeType& cursor);
     
     int readInt(const char* name, int defvalue);
     bool readBool(const char* name, bool defvalue);
@@ -46,6 +51,7 @@ private:
 private:
     Document _doc;
     std::vector<Value*> _stack;
+    std::vector<SizeType> _cursors;     // 各层下次查找子节点的起始成员序号，比_stack多一层(根)
     StringBuffer _strbuf;
     FileStream  *_fs;
     const char* _err;
@@ -131,6 +137,16 @@ const char* MgJsonStorage::getParseError()
 #endif
 }
 
+bool MgJsonStorage::copyTo(MgStorage* dest)
+{
+#ifdef RAPIDJSON_DOCUMENT_H_
+    return dest && _impl->copyTo(dest);
+#else
+    dest;
+    return false;
+#endif
+}
+
 MgStorage* MgJsonStorage::storageForWrite()
 {
 #ifdef RAPIDJSON_DOCUMENT_H_
@@ -147,6 +163,7 @@ void MgJsonStorage::Impl::clear()
 {
     _doc.SetNull();
     _stack.clear();
+    _cursors.clear();
     _strbuf.Clear();
     _nodeCount = 0;
     if (_fs) {
@@ -171,6 +188,30 @@ bool MgJsonStorage::Impl::setError(const char* err)
     return false;
 }
 
+// 从上次找到的成员之后开始循环查找，按序号顺序读取子节点时每次只需比较一个成员
+Value* MgJsonStorage::Impl::findChild(Value& parent, const char* name, SizeType& cursor)
+{
+    if (!parent.IsObject()) {
+        return NULL;
+    }
+    
+    Value::MemberIterator members = parent.MemberBegin();
+    SizeType count = static_cast<SizeType>(parent.MemberEnd() - members);
+    SizeType len = static_cast<SizeType>(strlen(name));
+    
+    for (SizeType i = 0; i < count; i++) {
+        SizeType pos = cursor + i < count ? cursor + i : cursor + i - count;
+        const Value &key = members[pos].name;
+        
+        if (key.GetStringLength() == len && memcmp(key.GetString(), name, len) == 0) {
+            cursor = pos + 1;
+            return &members[pos].value;
+        }
+    }
+    
+    return NULL;
+}
+
 bool MgJsonStorage::Impl::readNode(const char* name, int index, bool ended)
 {
     if (!ended) {                       // 开始一个新节点
@@ -185,23 +226,28 @@ bool MgJsonStorage::Impl::readNode(const char* name, int index, bool ended)
         }
         
         if (_stack.empty()) {
-            if (!_doc.IsObject() || !_doc.HasMember(name)) {
+            _cursors.resize(1, 0);
+            Value *node = findChild(_doc, name, _cursors[0]);
+            if (!node) {
                 return false;           // 没有此节点
             }
-            _stack.push_back(&_doc[name]);  // 当前JSON对象压栈
+            _stack.push_back(node);     // 当前JSON对象压栈
+            _cursors.push_back(0);
             _err = NULL;
         }
         else {
-            Value &parent = *_stack.back();
-            if (!parent.IsObject() || !parent.HasMember(name)) {
+            Value *node = findChild(*_stack.back(), name, _cursors[_stack.size()]);
+            if (!node) {
                 return false;
             }
-            _stack.push_back(&parent[name]);
+            _stack.push_back(node);
+            _cursors.push_back(0);
         }
     }
     else {                              // 当前节点读取完成
         if (!_stack.empty()) {
             _stack.pop_back();          // 出栈
+            _cursors.pop_back();
         }
         if (_stack.empty()) {           // 根节点已出栈
             clear();
@@ -308,6 +354,79 @@ static inline bool parseInt(const char* str, int& value)
     return !endptr || !*endptr;
 }
 
+static inline bool isUIntKey(const char* name)  // 用 writeUInt() 写出的键，其值为"0x"开头的字符串
+{
+    return strcmp(name, "lineColor") == 0 || strcmp(name, "fillColor") == 0
+        || strcmp(name, "flags") == 0;
+}
+
+static bool copyMembers(const Value& node, MgStorage* dest)
+{
+    std::vector<float> floats;
+    
+    for (Value::ConstMemberIterator it = node.MemberBegin(); it != node.MemberEnd(); ++it) {
+        const char* name = it->name.GetString();
+        const Value& item = it->value;
+        int value;
+        
+        if (item.IsObject()) {                  // "shape12" 还原为 ("shape", 11)
+            std::string prefix(name);
+            size_t n = prefix.find_last_not_of("0123456789") + 1;
+            int index = -1;
+            
+            if (n > 0 && n < prefix.size() && prefix[n] != '0') {
+                index = atoi(name + n) - 1;
+                prefix.resize(n);
+            }
+            dest->writeNode(prefix.c_str(), index, false);
+            if (!copyMembers(item, dest))
+                return false;
+            dest->writeNode(prefix.c_str(), index, true);
+        }
+        else if (item.IsBool()) {
+            dest->writeBool(name, item.GetBool());
+        }
+        else if (item.IsInt()) {
+            dest->writeInt(name, item.GetInt());
+        }
+        else if (item.IsUint()) {
+            dest->writeUInt(name, (int)item.GetUint());
+        }
+        else if (item.IsNumber()) {
+            dest->writeFloat(name, (float)item.GetDouble());
+        }
+        else if (item.IsString()) {
+            const char* str = item.GetString();
+            if (isUIntKey(name) && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')
+                && parseInt(str, value)) {
+                dest->writeUInt(name, value);
+            } else {
+                dest->writeString(name, str);
+            }
+        }
+        else if (item.IsArray()) {
+            floats.resize(item.Size() + 1);
+            for (SizeType i = 0; i < item.Size(); i++) {
+                if (!item[i].IsNumber()) {      // 存取接口只有浮点数数组，不能原样转换
+                    LOGD("Unsupported array element: %s[%d]", name, (int)i);
+                    return dest->setError("only number arrays can be copied");
+                }
+                floats[i] = (float)item[i].GetDouble();
+            }
+            dest->writeFloatArray(name, &floats.front(), (int)item.Size());
+        }
+    }
+    return true;
+}
+
+bool MgJsonStorage::Impl::copyTo(MgStorage* dest)
+{
+    if (!_doc.IsObject()) {
+        return false;
+    }
+    return copyMembers(_doc, dest);
+}
+
 int MgJsonStorage::Impl::readInt(const char* name, int defvalue)
 {
     int ret = defvalue;
@@ -485,8 +604,11 @@ void MgJsonStorage::Impl::writeFloatArray(const char* name, const float* values,
 
 void MgJsonStorage::Impl::writeString(const char* name, const char* value)
 {
+    if (!value) {
+        value = "";
+    }
     Value valueCopied(value, (unsigned)strlen(value), _doc.GetAllocator());
-    _stack.back()->AddMember(name, value ? value : "", _doc.GetAllocator());
+    _stack.back()->AddMember(name, valueCopied, _doc.GetAllocator());
 }
 
 #endif
@@ -0,0 +1,279 @@
+﻿// mgjsonwriter.cpp
+// Copyright (c) 2004-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#include "mgjsonwriter.h"
+#include "mgstorage.h"
+#include <string.h>
+#include "mglog.h"
+
+#if !defined(_MSC_VER) || _MSC_VER > 1200
+#include "rapidjson/writer.h"       // 与 MgJsonStorage::save() 用同样的输出格式
+#include "rapidjson/prettywriter.h"
+
+using namespace rapidjson;
+
+//! 带缓冲的输出流，输出到文件或回调函数
+struct MgJsonOutStream
+{
+    typedef char Ch;
+    
+    FILE*                   fp;
+    MgJsonWriter::WriteProc proc;
+    void*                   param;
+    int                     len;
+    char                    buf[4096];
+    
+    MgJsonOutStream() : fp(NULL), proc(NULL), param(NULL), len(0) {}
+    
+    void Put(char c) {
+        buf[len++] = c;
+        if (len == (int)sizeof(buf)) {
+            Flush();
+        }
+    }
+    void Flush() {
+        if (len > 0) {
+            if (fp) {
+                fwrite(buf, 1, len, fp);
+            } else if (proc) {
+                proc(param, buf, len);
+            }
+            len = 0;
+        }
+    }
+    
+    // 没用到的输入接口
+    Ch Peek() const { return 0; }
+    Ch Take() { return 0; }
+    size_t Tell() const { return 0; }
+    Ch* PutBegin() { return 0; }
+    size_t PutEnd(Ch*) { return 0; }
+};
+
+//! 流式JSON输出适配器类，内部实现类
+class MgJsonWriter::Impl : public MgStorage
+{
+public:
+    Impl() : _writer(NULL), _pretty(NULL), _depth(0), _ended(false) {}
+    virtual ~Impl() { clear(); }
+    
+    void clear();
+    void begin(bool pretty);
+    bool finish();
+    MgJsonOutStream& stream() { return _stream; }
+    
+private:
+    bool readNode(const char*, int, bool) { return false; }
+    bool writeNode(const char* name, int index, bool ended);
+    
+    bool readBool(const char*, bool defvalue) { return defvalue; }
+    float readFloat(const char*, float defvalue) { return defvalue; }
+    int readFloatArray(const char*, float*, int, bool) { return 0; }
+    int readString(const char*, char*, int) { return 0; }
+    
+    void writeInt(const char* name, int value);
+    void writeUInt(const char* name, int value);
+    void writeBool(const char* name, bool value);
+    void writeFloat(const char* name, float value);
+    void writeFloatArray(const char* name, const float* values, int count);
+    void writeString(const char* name, const char* value);
+    
+private:
+    void startObject() { if (_pretty) _pretty->StartObject(); else _writer->StartObject(); }
+    void endObject() { if (_pretty) _pretty->EndObject(); else _writer->EndObject(); }
+    void string(const char* str) {
+        if (_pretty) _pretty->String(str, (SizeType)strlen(str));
+        else _writer->String(str, (SizeType)strlen(str));
+    }
+    void number(double d) { if (_pretty) _pretty->Double(d); else _writer->Double(d); }
+    
+private:
+    MgJsonOutStream                 _stream;
+    Writer<MgJsonOutStream>*        _writer;
+    PrettyWriter<MgJsonOutStream>*  _pretty;
+    int                             _depth;     // 已开始的节点层数，不含根对象
+    bool                            _ended;     // 根对象是否已结束
+};
+
+#endif
+
+MgJsonWriter::MgJsonWriter() : _impl(NULL)
+{
+#ifdef RAPIDJSON_WRITER_H_
+    _impl = new Impl();
+#endif
+}
+
+MgJsonWriter::~MgJsonWriter()
+{
+#ifdef RAPIDJSON_WRITER_H_
+    delete _impl;
+#endif
+}
+
+MgStorage* MgJsonWriter::storageForWrite(FILE* fp, bool pretty)
+{
+#ifdef RAPIDJSON_WRITER_H_
+    _impl->clear();
+    _impl->stream().fp = fp;
+    _impl->begin(pretty);
+    return fp ? _impl : NULL;
+#else
+    fp; pretty;
+    return NULL;
+#endif
+}
+
+MgStorage* MgJsonWriter::storageForWrite(WriteProc proc, void* param, bool pretty)
+{
+#ifdef RAPIDJSON_WRITER_H_
+    _impl->clear();
+    _impl->stream().proc = proc;
+    _impl->stream().param = param;
+    _impl->begin(pretty);
+    return proc ? _impl : NULL;
+#else
+    proc; param; pretty;
+    return NULL;
+#endif
+}
+
+bool MgJsonWriter::finish()
+{
+#ifdef RAPIDJSON_WRITER_H_
+    return _impl->finish();
+#else
+    return false;
+#endif
+}
+
+#ifdef RAPIDJSON_WRITER_H_
+
+void MgJsonWriter::Impl::clear()
+{
+    delete _writer;
+    delete _pretty;
+    _writer = NULL;
+    _pretty = NULL;
+    _stream = MgJsonOutStream();
+    _depth = 0;
+    _ended = false;
+}
+
+void MgJsonWriter::Impl::begin(bool pretty)
+{
+    if (pretty) {
+        _pretty = new PrettyWriter<MgJsonOutStream>(_stream);
+    } else {
+        _writer = new Writer<MgJsonOutStream>(_stream);
+    }
+}
+
+bool MgJsonWriter::Impl::finish()
+{
+    _stream.Flush();
+    return _ended;
+}
+
+bool MgJsonWriter::Impl::writeNode(const char* name, int index, bool ended)
+{
+    if (!_writer && !_pretty) {
+        return false;
+    }
+    if (!ended) {                       // 开始一个新节点
+        char tmpname[32];
+        if (index >= 0) {               // 形成实际节点名称
+#if defined(_MSC_VER) && _MSC_VER >= 1400 // VC8
+            sprintf_s(tmpname, sizeof(tmpname), "%s%d", name, index + 1);
+#else
+            snprintf(tmpname, sizeof(tmpname), "%s%d", name, index + 1);
+#endif
+            name = tmpname;
+        }
+        if (_depth == 0) {
+            if (_ended) {
+                return false;           // 只能有一个根对象
+            }
+            startObject();              // 根对象
+        }
+        string(name);
+        startObject();
+        _depth++;
+    }
+    else if (_depth > 0) {              // 当前节点写完
+        endObject();
+        if (--_depth == 0) {
+            endObject();
+            _stream.Flush();
+            _ended = true;
+        }
+    }
+    
+    return true;
+}
+
+void MgJsonWriter::Impl::writeInt(const char* name, int value)
+{
+    if (_depth > 0) {
+        string(name);
+        if (_pretty) _pretty->Int(value); else _writer->Int(value);
+    }
+}
+
+void MgJsonWriter::Impl::writeUInt(const char* name, int value)
+{
+    if (_depth == 0) {
+        return;
+    }
+    string(name);
+    if (value >= 0 && value <= 0xFF) {
+        if (_pretty) _pretty->Uint((unsigned)value); else _writer->Uint((unsigned)value);
+    } else {
+        char buf[20];
+#if defined(_MSC_VER) && _MSC_VER >= 1400 // VC8
+        sprintf_s(buf, sizeof(buf), "0x%x", value);
+#else
+        snprintf(buf, sizeof(buf), "0x%x", value);
+#endif
+        string(buf);
+    }
+}
+
+void MgJsonWriter::Impl::writeBool(const char* name, bool value)
+{
+    if (_depth > 0) {
+        string(name);
+        if (_pretty) _pretty->Bool(value); else _writer->Bool(value);
+    }
+}
+
+void MgJsonWriter::Impl::writeFloat(const char* name, float value)
+{
+    if (_depth > 0) {
+        string(name);
+        number((double)value);
+    }
+}
+
+void MgJsonWriter::Impl::writeFloatArray(const char* name, const float* values, int count)
+{
+    if (_depth > 0) {
+        string(name);
+        if (_pretty) _pretty->StartArray(); else _writer->StartArray();
+        for (int i = 0; i < count; i++) {
+            number((double)values[i]);
+        }
+        if (_pretty) _pretty->EndArray(); else _writer->EndArray();
+    }
+}
+
+void MgJsonWriter::Impl::writeString(const char* name, const char* value)
+{
+    if (_depth > 0) {
+        string(name);
+        string(value ? value : "");
+    }
+}
+
+#endif
@@ -0,0 +1,154 @@
+﻿// recordindex.cpp
+// Copyright (c) 2013-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#include "recordindex.h"
+#include "mgjsonstorage.h"
+#include "mglog.h"
+#include <string.h>
+#include <vector>
+
+static const unsigned char kIndexMagic[] = { 'V', 'G', 'I', 1 };   // 文件标识和版本
+static const int kHeaderSize = 16;      // 标识, 记录字节数, 保留8字节
+static const int kFieldCount = 3;       // 时刻, 标志, 关键帧
+
+static void putInt(unsigned char* p, int value)
+{
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+static int getInt(const unsigned char* p)
+{
+    return (int)((unsigned)p[0] | (unsigned)p[1] << 8 | (unsigned)p[2] << 16 | (unsigned)p[3] << 24);
+}
+
+MgRecordIndex::MgRecordIndex() : _fp(NULL), _recordSize(kFieldCount * 4), _count(0)
+{
+}
+
+MgRecordIndex::~MgRecordIndex()
+{
+    close();
+}
+
+bool MgRecordIndex::create(const char* filename, int keepCount)
+{
+    std::vector<unsigned char> kept;
+    unsigned char header[kHeaderSize];
+    
+    close();
+    if (keepCount > 0 && open(filename)) {      // 续录时保留已有的记录
+        keepCount = keepCount < _count ? keepCount : _count;
+        kept.resize(keepCount * kFieldCount * 4);
+        for (int i = 0; i < keepCount; i++) {
+            for (int j = 0; j < kFieldCount; j++) {
+                putInt(&kept[(i * kFieldCount + j) * 4], readField(i, j));
+            }
+        }
+        _file.close();
+    }
+    
+    _fp = mgopenfile(filename, "wb");
+    if (!_fp) {
+        LOGE("Fail to save file: %s", filename);
+        return false;
+    }
+    
+    memset(header, 0, sizeof(header));
+    memcpy(header, kIndexMagic, sizeof(kIndexMagic));
+    putInt(header + 4, kFieldCount * 4);
+    _recordSize = kFieldCount * 4;
+    _count = (int)kept.size() / _recordSize;
+    
+    return fwrite(header, 1, sizeof(header), _fp) == sizeof(header)
+        && (kept.empty() || fwrite(&kept.front(), 1, kept.size(), _fp) == kept.size());
+}
+
+bool MgRecordIndex::write(int index, int tick, int flags, int keyframe)
+{
+    unsigned char rec[kFieldCount * 4];
+    
+    if (!_fp || index < 0 || index > _count) {
+        return false;
+    }
+    if (index < _count && fseek(_fp, kHeaderSize + index * _recordSize, SEEK_SET) != 0) {
+        return false;
+    }
+    putInt(rec, tick);
+    putInt(rec + 4, flags);
+    putInt(rec + 8, keyframe);
+    
+    bool ret = fwrite(rec, 1, sizeof(rec), _fp) == sizeof(rec);
+    
+    if (index < _count) {
+        fseek(_fp, 0, SEEK_END);
+    } else if (ret) {
+        _count++;
+    }
+    return ret;
+}
+
+void MgRecordIndex::flush()
+{
+    if (_fp) {
+        fflush(_fp);
+    }
+}
+
+bool MgRecordIndex::open(const char* filename)
+{
+    close();
+    if (!_file.open(filename)) {
+        return false;
+    }
+    
+    const unsigned char* p = _file.data();
+    
+    if (_file.size() < kHeaderSize || memcmp(p, kIndexMagic, 3) != 0
+        || getInt(p + 4) < 8) {
+        LOGE("Invalid frame index file: %s", filename);
+        _file.close();
+        return false;
+    }
+    _recordSize = getInt(p + 4);                // 记录末尾可增加字段，旧文件没有关键帧字段
+    _count = (_file.size() - kHeaderSize) / _recordSize;
+    
+    return true;
+}
+
+void MgRecordIndex::close()
+{
+    if (_fp) {
+        fclose(_fp);
+        _fp = NULL;
+    }
+    _file.close();
+    _count = 0;
+}
+
+int MgRecordIndex::readField(int index, int field) const
+{
+    if (!_file.data() || index < 0 || index >= _count || field * 4 >= _recordSize) {
+        return 0;
+    }
+    return getInt(_file.data() + kHeaderSize + index * _recordSize + field * 4);
+}
+
+int MgRecordIndex::findFrame(int tick) const
+{
+    int lo = 0, hi = _count - 1, ret = -1;
+    
+    while (lo <= hi) {                          // 各帧的时刻是递增的
+        int mid = (lo + hi) / 2;
+        if (getTick(mid) <= tick) {
+            ret = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,227 @@
+﻿// recordpack.cpp
+// Copyright (c) 2013-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#include "recordpack.h"
+#include "mgjsonstorage.h"
+#include "mglog.h"
+#include <string.h>
+#include <vector>
+
+static const unsigned char kPackMagic[] = { 'V', 'G', 'P', 1 };    // 文件标识和版本
+static const unsigned char kSegMagic[] = { 'V', 'G', 'S', 0 };     // 数据段标识
+static const unsigned char kEndMagic[] = { 'V', 'G', 'P', 'T' };   // 目录结尾标识
+static const int kHeaderSize = 16;      // 标识, 保留12字节
+static const int kSegHeadSize = 12;     // 标识, 名称长度, 内容长度
+static const int kTailSize = 12;        // 目录位置, 段数, 标识
+
+static void putInt(unsigned char* p, int value)
+{
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+    p[2] = (unsigned char)(value >> 16);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+static int getInt(const unsigned char* p)
+{
+    return (int)((unsigned)p[0] | (unsigned)p[1] << 8 | (unsigned)p[2] << 16 | (unsigned)p[3] << 24);
+}
+
+MgRecordPack::MgRecordPack() : _fp(NULL), _dataEnd(kHeaderSize), _dirty(false)
+{
+}
+
+MgRecordPack::~MgRecordPack()
+{
+    close();
+}
+
+bool MgRecordPack::create(const char* filename)
+{
+    close();
+    if (open(filename)) {                       // 续写时在原目录处追加
+        _file.close();
+        _fp = mgopenfile(filename, "r+b");
+    } else {
+        unsigned char header[kHeaderSize];
+        
+        _items.clear();
+        _dataEnd = kHeaderSize;
+        _fp = mgopenfile(filename, "wb");
+        if (_fp) {
+            memset(header, 0, sizeof(header));
+            memcpy(header, kPackMagic, 4);
+            fwrite(header, 1, kHeaderSize, _fp);
+        }
+    }
+    if (!_fp) {
+        LOGE("Fail to save file: %s", filename);
+        return false;
+    }
+    _dirty = true;
+    
+    return true;
+}
+
+bool MgRecordPack::write(const char* name, const void* data, int size)
+{
+    unsigned char head[kSegHeadSize];
+    int len = (int)strlen(name);
+    
+    if (!_fp || size < 0) {
+        return false;
+    }
+    memcpy(head, kSegMagic, 4);
+    putInt(head + 4, len);
+    putInt(head + 8, size);
+    
+    bool ret = (fseek(_fp, _dataEnd, SEEK_SET) == 0
+                && fwrite(head, 1, kSegHeadSize, _fp) == (size_t)kSegHeadSize
+                && fwrite(name, 1, len, _fp) == (size_t)len
+                && (size == 0 || fwrite(data, 1, size, _fp) == (size_t)size));
+    if (ret) {
+        _items[name] = std::make_pair(_dataEnd + kSegHeadSize + len, size);
+        _dataEnd += kSegHeadSize + len + size;
+        _dirty = true;
+    }
+    
+    return ret;
+}
+
+void MgRecordPack::flush()
+{
+    if (!_fp || !_dirty) {
+        return;
+    }
+    
+    std::vector<unsigned char> buf;
+    unsigned char tmp[4];
+    
+    for (Items::const_iterator it = _items.begin(); it != _items.end(); ++it) {
+        putInt(tmp, (int)it->first.size());
+        buf.insert(buf.end(), tmp, tmp + 4);
+        buf.insert(buf.end(), it->first.begin(), it->first.end());
+        putInt(tmp, it->second.first);
+        buf.insert(buf.end(), tmp, tmp + 4);
+        putInt(tmp, it->second.second);
+        buf.insert(buf.end(), tmp, tmp + 4);
+    }
+    putInt(tmp, _dataEnd);
+    buf.insert(buf.end(), tmp, tmp + 4);
+    putInt(tmp, (int)_items.size());
+    buf.insert(buf.end(), tmp, tmp + 4);
+    buf.insert(buf.end(), kEndMagic, kEndMagic + 4);
+    
+    // 段只增不减，新目录的结尾不会早于旧目录的结尾，不用截断文件
+    fseek(_fp, _dataEnd, SEEK_SET);
+    fwrite(&buf.front(), 1, buf.size(), _fp);
+    fflush(_fp);
+    _dirty = false;
+}
+
+bool MgRecordPack::open(const char* filename)
+{
+    close();
+    if (!_file.open(filename)) {
+        return false;
+    }
+    
+    const unsigned char* p = (const unsigned char*)_file.data();
+    int size = (int)_file.size();
+    
+    if (size < kHeaderSize || memcmp(p, kPackMagic, 4) != 0) {
+        LOGE("Invalid record pack: %s", filename);
+        _file.close();
+        return false;
+    }
+    if (!loadItems(p, size)) {
+        LOGD("Scan %d segments in %s", scanItems(p, size), filename);
+    }
+    
+    return true;
+}
+
+bool MgRecordPack::loadItems(const unsigned char* data, int size)
+{
+    if (size < kHeaderSize + kTailSize) {
+        return false;
+    }
+    
+    const unsigned char* tail = data + size - kTailSize;
+    int pos = getInt(tail);
+    int count = getInt(tail + 4);
+    
+    if (memcmp(tail + 8, kEndMagic, 4) != 0 || pos < kHeaderSize || pos > size - kTailSize) {
+        return false;
+    }
+    
+    _items.clear();
+    _dataEnd = pos;
+    for (int i = 0; i < count; i++) {
+        if (pos + 4 > size - kTailSize) {
+            return false;
+        }
+        int len = getInt(data + pos);
+        
+        if (len < 0 || pos + 12 + len > size - kTailSize) {
+            return false;
+        }
+        std::string name((const char*)data + pos + 4, len);
+        int offset = getInt(data + pos + 4 + len);
+        int n = getInt(data + pos + 8 + len);
+        
+        if (offset < kHeaderSize || n < 0 || offset + n > _dataEnd) {
+            return false;
+        }
+        _items[name] = std::make_pair(offset, n);
+        pos += 12 + len;
+    }
+    
+    return true;
+}
+
+int MgRecordPack::scanItems(const unsigned char* data, int size)
+{
+    int pos = kHeaderSize;
+    
+    _items.clear();
+    while (pos + kSegHeadSize <= size && memcmp(data + pos, kSegMagic, 4) == 0) {
+        int len = getInt(data + pos + 4);
+        int n = getInt(data + pos + 8);
+        
+        if (len < 0 || n < 0 || pos + kSegHeadSize + len + n > size) {
+            break;                              // 最后一段未写完整
+        }
+        _items[std::string((const char*)data + pos + kSegHeadSize, len)]
+            = std::make_pair(pos + kSegHeadSize + len, n);
+        pos += kSegHeadSize + len + n;
+    }
+    _dataEnd = pos;
+    
+    return (int)_items.size();
+}
+
+void MgRecordPack::close()
+{
+    if (_fp) {
+        flush();
+        fclose(_fp);
+        _fp = NULL;
+    }
+    _file.close();
+    _items.clear();
+    _dataEnd = kHeaderSize;
+}
+
+const unsigned char* MgRecordPack::find(const char* name, int& size) const
+{
+    Items::const_iterator it = _items.find(name);
+    
+    if (!_file.data() || it == _items.end()) {
+        size = 0;
+        return NULL;
+    }
+    size = it->second.second;
+    return (const unsigned char*)_file.data() + it->second.first;
+}
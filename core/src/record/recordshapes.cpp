@@ -3,23 +3,105 @@
 // License: LGPL, https://github.com/rhcad/touchvg
 
 #include "recordshapes.h"
+#include "recordindex.h"
+#include "recordpack.h"
 #include "mgshapedoc.h"
 #include "mglayer.h"
 #include "mgbasicsp.h"
 #include "mgjsonstorage.h"
+#include "mgbinstorage.h"
 #include "mgstorage.h"
 #include "mgvector.h"
 #include "mglog.h"
+#include "githread.h"
 #include <sstream>
 #include <map>
+#include <deque>
 
 static const bool VG_PRETTY = false;
+static const int UNDO_MEMORY_BUDGET = 4 * 1024 * 1024;
+static const int KEYFRAME_FRAMES = 100;
+static const int KEYFRAME_BYTES = 1024 * 1024;
+static const int SKIP_LAYER = -2;       // 读帧时不需要的图层
+
+//! 形成删除的图形ID的键名 d0, d1...
+static const char* deletedKey(char* buf, int index)
+{
+#if defined(_MSC_VER) && _MSC_VER >= 1400 // VC8
+    sprintf_s(buf, 16, "d%d", index);
+#else
+    snprintf(buf, 16, "d%d", index);
+#endif
+    return buf;
+}
+
+//! 内存中的撤销步骤，内容与同序号的 .vgr/.vgu 文件相同但为二进制格式
+struct MgUndoStep
+{
+    int index;                                  // 步骤序号
+    std::vector<unsigned char> data[2];         // 重做和撤销内容，空表示无此文件
+    
+    int bytes() const { return (int)(data[0].size() + data[1].size()); }
+};
+
+//! 待写线程录制的一帧，图形为只读的快照
+struct MgRecordItem
+{
+    long        tick;
+    long        changeCount;
+    MgShapeDoc* doc;
+    MgShapes*   shapes;
+};
+
+//! 从一帧录制内容读出的变动，图形已创建好，主线程只需将其并入文档和动态图形
+struct MgRecordFrame
+{
+    int         flags;                  // 帧的 ADD/EDIT/DYN 标志
+    int         tick;                   // 帧的时间，-1表示没有
+    long        changeCount;            // 文档的改变次数，-1表示没有
+    bool        viewChanged;            // 是否有显示变换
+    Matrix2d    transform;
+    int         extentCount;            // 读到的 pageExtent 分量个数
+    Box2d       pageExtent;
+    float       viewScale;              // 0表示不变
+    int         loaded;                 // 读 shapes 的结果，>0 表示有增加或修改的图形
+    MgShapes*   shapes;                 // 增加或修改的图形，索引同所读的图层
+    std::vector<int> deleted;           // 删除的图形ID
+    int         dynLoaded;              // 读动态图形的结果，>=0 表示有效
+    MgShapes*   dynShapes;              // 动态图形，NULL表示没有 dynamic 节点
+    std::vector<float> dyninc;          // 增量记录的动态图形新增点坐标
+    
+    MgRecordFrame() : flags(0), tick(-1), changeCount(-1), viewChanged(false)
+        , extentCount(0), viewScale(0), loaded(0), shapes(NULL), dynLoaded(-1), dynShapes(NULL) {}
+    ~MgRecordFrame() {
+        MgObject::release_pointer(shapes);
+        MgObject::release_pointer(dynShapes);
+    }
+    
+    //! 预读时所用图层是否与应用时的图层一致
+    bool matches(MgShapeDoc* doc, MgShapes* dyns) const {
+        return (!doc || !shapes || shapes->getIndex() == doc->getCurrentLayer()->getIndex())
+            && (!dyns || !dynShapes || dynShapes->getIndex() == dyns->getIndex());
+    }
+};
+
+//! 播放时预读好的一帧，在主线程中应用
+struct MgFrameItem
+{
+    int             index;              // 帧序号，0表示没有
+    int             bytes;
+    float           parseTime;          // 解析和创建图形的时间
+    MgRecordFrame*  frame;              // NULL表示帧内容有误，播放时改为同步读取
+    
+    void free() { delete frame; frame = NULL; index = 0; }
+};
 
 struct MgRecordShapes::Impl
 {
     std::string     path;
     int             type;
     std::map<int, long>  id2ver;
+    long            journalId, journalPos;  // 已记录到的图形变动日志位置
     volatile int    fileCount;
     volatile int    maxCount;
     volatile long   loading;
@@ -29,17 +111,60 @@ struct MgRecordShapes::Impl
     int             tick, lastTick;
     int             flags[2];
     int             shapeCount;
-    MgJsonStorage   *js[3];
-    MgStorage       *s[3];
+    MgJsonStorage   *js[2];
+    MgBinStorage    *bs[2];
+    MgStorage       *s[2];
+    MgRecordIndex   *frames;            // 录制或播放时的帧索引
+    MgRecordPack    *pack;              // 录制或播放时的帧容器文件，NULL表示每帧一个文件
+    bool            packed;             // 是否录制到帧容器文件，开始录制后不再改变
+    bool            reportPack;         // 帧容器文件关闭后是否还要报告给调用者
+    bool            configured;         // 是否已开始录制，此后不再改变录制格式
+    int             keyframe;           // 最近一个关键帧的序号
+    int             keyFrames, keyBytes;    // 写关键帧的间隔帧数和间隔字节数
+    int             deltaBytes;         // 最近一个关键帧后的帧文件字节数
+    std::deque<MgUndoStep>  steps;      // 内存中的撤销步骤，序号递增，录制线程和主线程共用
+    GiMutex         stepsLock;          // 保护 steps 和 memBytes
+    int             memBytes;
+    int             budget;
+    bool            spillOnStop;        // 结束时是否写出内存中的撤销步骤，以便以后 restore() 续用
+    GiThread        writer;             // 录制时的写线程
+    GiRingQueue<MgRecordItem, 16> pending;  // 待写的帧
+    GiSignal        queued;             // 有新的帧或要结束时通知写线程
+    GiSignal        dequeued;           // 写线程取走帧后通知录制线程
+    volatile long   lastWritten;        // 写线程已写出的最后一帧序号，帧序号连续递增
+    long            reported;           // 已报告给调用者的最后一帧序号
+    volatile long   stopping;
+    GiThread        prefetcher;         // 播放时的预读线程
+    GiRingQueue<MgFrameItem, 64> ready; // 已解析待应用的帧
+    MgFrameItem     held;               // 已取出但还未到播放位置的帧
+    volatile long   prefetchStop;
+    volatile long   bytesAhead;         // 已解析待应用的帧文件字节数
+    int             prefetchBytes;      // 预读的字节数上限
+    int             prefetchIndex;      // 预读线程要读的下一帧
+    MgShapeFactory* factory;            // 预读线程创建图形所用的工厂
+    int             layerIndex;         // 预读时读入的图层序号
+    int             appliedCount;       // 用预读帧播放的帧数
+    double          parseTotal, applyTotal;
+    bool            binary;             // 录制帧是否为二进制格式
+    float           precision;          // 二进制录制帧的坐标精度
     
-    Impl(long curTick) : fileCount(0), maxCount(0), loading(0), lastDoc(NULL)
-        , lastShape(NULL), startTick(curTick), tick(0), lastTick(0)
+    Impl(long curTick) : journalId(0), journalPos(0), fileCount(0), maxCount(0)
+        , loading(0), lastDoc(NULL), lastShape(NULL), startTick(curTick), tick(0), lastTick(0)
+        , frames(NULL), pack(NULL), packed(false), reportPack(false), configured(false), keyframe(0)
+        , keyFrames(KEYFRAME_FRAMES), keyBytes(KEYFRAME_BYTES), deltaBytes(0), memBytes(0)
+        , budget(UNDO_MEMORY_BUDGET), spillOnStop(false), lastWritten(0), reported(0), stopping(0)
+        , prefetchStop(0), bytesAhead(0), prefetchBytes(0), prefetchIndex(0), factory(NULL), layerIndex(0)
+        , appliedCount(0), parseTotal(0), applyTotal(0), binary(false), precision(0)
     {
+        memset(&held, 0, sizeof(held));
         memset(flags, 0, sizeof(flags));
         memset(js, 0, sizeof(js));
+        memset(bs, 0, sizeof(bs));
         memset(s, 0, sizeof(s));
     }
     ~Impl() {
+        delete frames;
+        delete pack;
         MgObject::release_pointer(lastDoc);
         MgObject::release_pointer(lastShape);
     }
@@ -49,11 +174,35 @@ struct MgRecordShapes::Impl
     std::string getFileName(bool back, int index = -1) const;
     void resetVersion(const MgShapes* shapes);
     void startRecord();
+    void configure(MgRecordShapes* owner);
+    void stopWriter();
+    void stopPrefetch();
+    bool takeFrame(int index, MgFrameItem& item);
+    bool parseFrame(int index, MgFrameItem& item);
+    static bool readFrame(MgShapeFactory *f, MgStorage* s, MgRecordFrame& frame,
+                          MgShapes* layer, int layerIndex, int dynIndex);
+    static int applyFrame(int& tick, MgShapeDoc* doc, MgShapes* dyns,
+                          MgRecordFrame& frame, long* changeCount, MgShape* lastShape);
+    static void addBytes(volatile long& v, long n) {
+        long old;
+        do {
+            old = v;
+        } while (!giAtomicCompareAndSwap(&v, old + n, old));
+    }
     void stopRecordIndex();
-    bool saveIndexFile(bool ended);
+    void saveFrameIndex();
+    void saveKeyframe();
+    bool saveFile(const std::string& filename, MgJsonStorage* js, MgBinStorage* bs);
+    void openPack();
+    MgStorage* readPacked(const std::string& filename, MgJsonStorage& js, MgBinStorage& bs) const;
+    bool loadKeyframe(MgShapeFactory *f, MgShapeDoc* doc, int index);
     void recordShapes(const MgShapes* shapes);
+    void recordShape(const MgShapes* shapes, const MgShape* sp, std::vector<int>& newids, int& i2);
     bool forUndo() const { return type == 0; }
     bool incrementRecord(MgShapes* dynShapes);
+    void pushStep(std::vector<unsigned char>* data);
+    void spillStep();
+    const MgUndoStep* findStep(int index) const;
 };
 
 MgRecordShapes::MgRecordShapes(const char* path, MgShapeDoc* doc, bool forUndo, long curTick)
@@ -69,6 +218,9 @@ MgRecordShapes::MgRecordShapes(const char* path, MgShapeDoc* doc, bool forUndo,
         _im->resetVersion(doc->getCurrentLayer());
         _im->startRecord();
     }
+    if (_im->type == 2) {
+        _im->openPack();                        // 有帧容器文件就从中播放
+    }
 }
 
 MgRecordShapes::~MgRecordShapes()
@@ -107,6 +259,48 @@ int MgRecordShapes::getMaxFileCount() const
     return _im->maxCount;
 }
 
+void MgRecordShapes::setMemoryBudget(int bytes, bool spillOnStop)
+{
+    GiMutex::Lock lock(_im->stepsLock);
+    
+    _im->budget = bytes > 0 ? bytes : 0;
+    _im->spillOnStop = spillOnStop;
+    while (_im->memBytes > _im->budget && !_im->steps.empty()) {
+        _im->spillStep();
+    }
+}
+
+int MgRecordShapes::getMemoryBytes() const
+{
+    return _im->memBytes;
+}
+
+bool MgRecordShapes::setKeyframeInterval(int frames, int bytes)
+{
+    if (_im->configured)                        // 写线程已在使用
+        return false;
+    _im->keyFrames = frames;
+    _im->keyBytes = bytes;
+    return true;
+}
+
+bool MgRecordShapes::setPackFile(bool packed)
+{
+    if (_im->configured)
+        return false;
+    _im->packed = packed && !_im->forUndo();
+    return true;
+}
+
+bool MgRecordShapes::setBinaryFormat(bool binary, float precision)
+{
+    if (_im->configured)
+        return false;
+    _im->precision = precision;
+    _im->binary = binary;
+    return true;
+}
+
 long MgRecordShapes::getCurrentTick(long curTick) const
 {
     return curTick - _im->startTick;
@@ -119,6 +313,87 @@ bool MgRecordShapes::onResume(long ticks)
 
 bool MgRecordShapes::recordStep(long tick, long changeCount, MgShapeDoc* doc,
                                 MgShapes* dynShapes, const std::vector<MgShapes*>& extShapes)
+{
+    if (!extShapes.empty()) {
+        MgShapes* newsp = MgShapes::create();
+        newsp->copyShapes(dynShapes, false, false);
+        for (size_t i = 0; i < extShapes.size(); i++) {
+            newsp->copyShapes(extShapes[i], false, false);
+        }
+        MgObject::release_pointer(dynShapes);
+        dynShapes = newsp;
+    }
+    if (!_im->configured) {                         // 录制格式从此固定，再启动写线程
+        _im->configure(this);
+    }
+    if (!_im->writer.isStarted()) {                 // 撤销记录在本线程写
+        return writeStep(tick, changeCount, doc, dynShapes);
+    }
+    
+    MgRecordItem item = { tick, changeCount, doc, dynShapes };
+    
+    while (!_im->pending.push(item)) {              // 队列满时等写线程赶上
+        _im->dequeued.wait();
+    }
+    _im->queued.signal();
+    return true;
+}
+
+void MgRecordShapes::Impl::configure(MgRecordShapes* owner)
+{
+    configured = true;
+    if (packed) {
+        std::string packfile(path + MgRecordPack::fileName());
+        pack = new MgRecordPack();
+        if (pack->create(packfile.c_str())) {
+            reportPack = true;
+        } else {
+            delete pack;
+            pack = NULL;
+            packed = false;                     // 改为每帧一个文件
+        }
+    }
+    if (type == 1 && !writer.start(writerProc, owner)) {
+        LOGE("Fail to start the record writer, record synchronously");
+    }
+}
+
+void MgRecordShapes::writerProc(void* param)
+{
+    MgRecordShapes* p = (MgRecordShapes*)param;
+    MgRecordItem item;
+    
+    for (;;) {
+        bool stopping = p->_im->stopping != 0;      // 先检查再取，以免漏掉最后的帧
+        
+        if (p->_im->pending.pop(item)) {
+            p->_im->dequeued.signal();
+            p->writeStep(item.tick, item.changeCount, item.doc, item.shapes);
+        } else if (stopping) {
+            break;
+        } else {
+            p->_im->queued.wait();                  // 等待新的帧或结束通知
+        }
+    }
+}
+
+bool MgRecordShapes::popWrittenFile(std::string& filename)
+{
+    if (_im->packed) {                              // 没有单独的帧文件，录制结束后报告容器文件
+        _im->reported = _im->lastWritten;
+        if (!_im->reportPack || !_im->pack || _im->pack->isCreated())
+            return false;
+        _im->reportPack = false;
+        filename = _im->path + MgRecordPack::fileName();
+        return true;
+    }
+    if (_im->reported >= _im->lastWritten)
+        return false;
+    filename = _im->getFileName(false, (int)++_im->reported);
+    return true;
+}
+
+bool MgRecordShapes::writeStep(long tick, long changeCount, MgShapeDoc* doc, MgShapes* dynShapes)
 {
     _im->beginJsonFile();
     _im->tick = (int)tick;
@@ -134,15 +409,6 @@ bool MgRecordShapes::recordStep(long tick, long changeCount, MgShapeDoc* doc,
         _im->lastDoc = doc;
     }
     
-    if (!extShapes.empty()) {
-        MgShapes* newsp = MgShapes::create();
-        newsp->copyShapes(dynShapes, false, false);
-        for (size_t i = 0; i < extShapes.size(); i++) {
-            newsp->copyShapes(extShapes[i], false, false);
-        }
-        MgObject::release_pointer(dynShapes);
-        dynShapes = newsp;
-    }
     if (needDyn && dynShapes && dynShapes->getShapeCount() > 0) {
         if (!_im->incrementRecord(dynShapes)) {
             _im->flags[0] |= DYN;
@@ -161,15 +427,13 @@ bool MgRecordShapes::recordStep(long tick, long changeCount, MgShapeDoc* doc,
     
     bool ret = _im->saveJsonFile();
     
-    if (ret && _im->s[2]) {
-        _im->s[2]->writeNode("r", _im->fileCount - 2, false);
-        _im->s[2]->writeInt("tick", _im->tick);
-        _im->s[2]->writeInt("flags", _im->flags[0]);
-        _im->s[2]->writeNode("r", _im->fileCount - 2, true);
-        
-        if (_im->fileCount % 10 == 0 || _im->flags[0] != MgRecordShapes::DYN) {
-            _im->saveIndexFile(false);
-        }
+    if (ret && !_im->forUndo()) {                   // 撤销步骤可能只在内存中，不报告
+        giMemoryBarrier();
+        _im->lastWritten = _im->fileCount - 1;
+    }
+    if (ret && _im->frames) {
+        _im->saveKeyframe();
+        _im->saveFrameIndex();
     }
     
     return ret;
@@ -216,28 +480,31 @@ void MgRecordShapes::resetDoc(MgShapeDoc* doc)
 
 void MgRecordShapes::restore(int index, int count, int tick, long curTick)
 {
-    std::vector<int> arr;
-    
-    if (_im->s[2] && loadFrameIndex(_im->path, arr)) {
-        for (unsigned i = 0; i + 2 < arr.size(); i += 3) {
-            _im->s[2]->writeNode("r", i / 3, false);
-            _im->s[2]->writeInt("tick", arr[i + 1]);
-            _im->s[2]->writeInt("flags", arr[i + 2]);
-            _im->s[2]->writeNode("r", i / 3, true);
-        }
-    }
-    _im->fileCount = index;
+    _im->fileCount = index;                     // 续录时帧索引保留此前的记录
     _im->maxCount = count ? count : index;
     _im->startTick = curTick - tick;
-    LOGD("restore fileCount=%d, maxCount=%d, startTick=%d, frames=%d",
-         _im->fileCount, _im->maxCount, tick, (int)arr.size() / 3);
+    _im->lastWritten = _im->reported = mgMax(index, 1) - 1;   // 续录的第一帧序号为 index
+    LOGD("restore fileCount=%d, maxCount=%d, startTick=%d",
+         _im->fileCount, _im->maxCount, tick);
 }
 
 bool MgRecordShapes::loadFrameIndex(std::string path, std::vector<int>& arr)
 {
     if (*path.rbegin() != '/' && *path.rbegin() != '\\')
         path += '/';
-    path += "records.json";
+    
+    MgRecordIndex index;
+    
+    if (index.open((path + MgRecordIndex::fileName()).c_str())) {
+        for (int i = 0; i < index.getCount(); i++) {
+            arr.push_back(i + 1);
+            arr.push_back(index.getTick(i));
+            arr.push_back(index.getFlags(i));
+        }
+        return true;
+    }
+    
+    path += "records.json";                     // 旧版本的帧索引
     
     FILE *fp = mgopenfile(path.c_str(), "rt");
     if (!fp) {
@@ -301,14 +568,14 @@ bool MgRecordShapes::undo(MgShapeFactory *factory, MgShapeDoc* doc, long* change
     
     giAtomicIncrement(&_im->loading);
     
-    std::string fn(_im->getFileName(true, _im->fileCount - 1));
-    int ret = applyFile(_im->tick, factory, doc, NULL, fn.c_str(), changeCount);
+    int index = _im->fileCount - 1;
+    int ret = applyStep(true, index, factory, doc, NULL, changeCount);
     
     if (ret) {
         _im->fileCount--;
         _im->resetVersion(doc->getCurrentLayer());
         MgObject::release_pointer(_im->lastDoc);
-        LOGD("Undo with %s", fn.c_str());
+        LOGD("Undo with step %d", index);
     }
     giAtomicDecrement(&_im->loading);
     
@@ -322,14 +589,14 @@ bool MgRecordShapes::redo(MgShapeFactory *factory, MgShapeDoc* doc, long* change
     
     giAtomicIncrement(&_im->loading);
     
-    std::string fn(_im->getFileName(false, _im->fileCount));
-    int ret = applyFile(_im->tick, factory, doc, NULL, fn.c_str(), changeCount);
+    int index = _im->fileCount;
+    int ret = applyStep(false, index, factory, doc, NULL, changeCount);
     
     if (ret) {
         _im->fileCount++;
         _im->resetVersion(doc->getCurrentLayer());
         MgObject::release_pointer(_im->lastDoc);
-        LOGD("Redo with %s", fn.c_str());
+        LOGD("Redo with step %d", index);
     }
     giAtomicDecrement(&_im->loading);
     
@@ -338,51 +605,50 @@ bool MgRecordShapes::redo(MgShapeFactory *factory, MgShapeDoc* doc, long* change
 
 void MgRecordShapes::Impl::recordShapes(const MgShapes* shapes)
 {
-    MgShapeIterator it(shapes);
-    std::map<int, long> tmpids(id2ver);
     std::map<int, long>::iterator i;
     int i2 = 0;
     int sid;
-    std::vector<int> newids;
+    std::vector<int> ids, newids, delids;
+    char key[16];
     
     s[0]->writeNode("shapes", shapes->getIndex(), false);
     s[1]->writeNode("shapes", shapes->getIndex(), false);
     
-    while (const MgShape* sp = it.getNext()) {
-        sid = sp->getID();
-        i = id2ver.find(sid);                                   // 查找是否之前已存在
-        
-        if (i == id2ver.end()) {                                // 是新增的图形
-            newids.push_back(sid);
-            id2ver[sid] = sp->shapec()->getChangeCount();       // 增加记录版本
-            shapes->saveShape(s[0], sp, shapeCount++);          // 写图形节点
-            flags[0] |= flags[0] ? EDIT : ADD;
-        } else {
-            tmpids.erase(tmpids.find(sid));                     // 标记是已有图形
-            if (i->second != sp->shapec()->getChangeCount()) {  // 改变的图形
-                i->second = sp->shapec()->getChangeCount();
-                id2ver[sid] = sp->shapec()->getChangeCount();   // 更新版本
-                shapes->saveShape(s[0], sp, shapeCount++);
-                flags[0] |= EDIT;
-                i2 += shapes->saveShape(s[1], lastDoc->findShape(sid), i2) ? 1 : 0;
-                flags[1] |= EDIT;
+    if (shapes->getChangedIDs(journalId, journalPos, ids)) {   // 只检查变动过的图形
+        for (unsigned j = 0; j < ids.size(); j++) {
+            const MgShape* sp = shapes->findShape(ids[j]);
+            
+            if (sp) {
+                recordShape(shapes, sp, newids, i2);
+            } else if ((i = id2ver.find(ids[j])) != id2ver.end()) {
+                delids.push_back(ids[j]);
+                id2ver.erase(i);
             }
         }
+    } else {                                                    // 比较全部图形
+        MgShapeIterator it(shapes);
+        std::map<int, long> tmpids(id2ver);
+        
+        while (const MgShape* sp = it.getNext()) {
+            tmpids.erase(sp->getID());                          // 标记是已有图形
+            recordShape(shapes, sp, newids, i2);
+        }
+        for (i = tmpids.begin(); i != tmpids.end(); ++i) {
+            delids.push_back(i->first);
+            id2ver.erase(i->first);
+        }
     }
+    journalPos = shapes->getJournalPos(journalId);
+    
     s[0]->writeNode("shapes", shapes->getIndex(), true);
-    s[0]->writeInt("count", shapeCount += (int)tmpids.size());
+    s[0]->writeInt("count", shapeCount += (int)delids.size());
     
-    if (!tmpids.empty()) {                                      // 之前存在，现在已删除
+    if (!delids.empty()) {                                      // 之前存在，现在已删除
         flags[0] |= DEL;
         s[0]->writeNode("delete", -1, false);
-        int j = 0;
-        for (i = tmpids.begin(); i != tmpids.end(); ++i) {
-            sid = i->first;
-            id2ver.erase(id2ver.find(sid));
-            
-            std::stringstream ss;
-            ss << "d" << j++;
-            s[0]->writeInt(ss.str().c_str(), sid);              // 记下删除的图形的ID
+        for (unsigned j = 0; j < delids.size(); j++) {
+            sid = delids[j];
+            s[0]->writeInt(deletedKey(key, j), sid);            // 记下删除的图形的ID
             flags[1] |= ADD;
             i2 += shapes->saveShape(s[1], lastDoc->findShape(sid), i2) ? 1 : 0;
         }
@@ -395,9 +661,7 @@ void MgRecordShapes::Impl::recordShapes(const MgShapes* shapes)
         flags[1] |= DEL;
         s[1]->writeNode("delete", -1, false);
         for (unsigned j = 0; j < newids.size(); j++) {
-            std::stringstream ss;
-            ss << "d" << j;
-            s[1]->writeInt(ss.str().c_str(), newids[j]);
+            s[1]->writeInt(deletedKey(key, j), newids[j]);
         }
         s[1]->writeNode("delete", -1, true);
     }
@@ -405,6 +669,27 @@ void MgRecordShapes::Impl::recordShapes(const MgShapes* shapes)
     s[1]->writeInt("count", i2 + (int)newids.size());
 }
 
+void MgRecordShapes::Impl::recordShape(const MgShapes* shapes, const MgShape* sp,
+                                        std::vector<int>& newids, int& i2)
+{
+    int sid = sp->getID();
+    std::map<int, long>::iterator i = id2ver.find(sid);     // 查找是否之前已存在
+    
+    if (i == id2ver.end()) {                                // 是新增的图形
+        newids.push_back(sid);
+        id2ver[sid] = sp->shapec()->getChangeCount();       // 增加记录版本
+        shapes->saveShape(s[0], sp, shapeCount++);          // 写图形节点
+        flags[0] |= flags[0] ? EDIT : ADD;
+    }
+    else if (i->second != sp->shapec()->getChangeCount()) { // 改变的图形
+        i->second = sp->shapec()->getChangeCount();         // 更新版本
+        shapes->saveShape(s[0], sp, shapeCount++);
+        flags[0] |= EDIT;
+        i2 += shapes->saveShape(s[1], lastDoc->findShape(sid), i2) ? 1 : 0;
+        flags[1] |= EDIT;
+    }
+}
+
 void MgRecordShapes::Impl::resetVersion(const MgShapes* shapes)
 {
     MgShapeIterator it(shapes);
@@ -413,14 +698,13 @@ void MgRecordShapes::Impl::resetVersion(const MgShapes* shapes)
     while (const MgShape* sp = it.getNext()) {
         id2ver[sp->getID()] = sp->shapec()->getChangeCount();
     }
+    journalPos = shapes->getJournalPos(journalId);
 }
 
 void MgRecordShapes::Impl::startRecord()
 {
     if (!forUndo()) {
-        js[2] = new MgJsonStorage();
-        s[2] = js[2]->storageForWrite();
-        s[2]->writeNode("records", -1, false);
+        frames = new MgRecordIndex();
     }
 }
 
@@ -434,8 +718,14 @@ void MgRecordShapes::Impl::beginJsonFile()
     shapeCount = 0;
     
     for (int i = 0; i < 2; i++) {
-        js[i] = new MgJsonStorage();
-        s[i] = js[i]->storageForWrite();
+        if (forUndo() || binary) {              // 撤销步骤先保存在内存中
+            bs[i] = new MgBinStorage();
+            bs[i]->setPrecision(forUndo() ? 0 : precision);
+            s[i] = bs[i]->storageForWrite();
+        } else {
+            js[i] = new MgJsonStorage();
+            s[i] = js[i]->storageForWrite();
+        }
         s[i]->writeNode("record", -1, false);
         s[i]->writeInt("tick", tick);
     }
@@ -454,6 +744,7 @@ bool MgRecordShapes::Impl::saveJsonFile()
 {
     bool ret = false;
     std::string filename;
+    std::vector<unsigned char> data[2];
     
     if (flags[0] == DYN && tick - lastTick < 20) {
         //LOGD("Ignore record at the same time %d", tick);
@@ -466,22 +757,21 @@ bool MgRecordShapes::Impl::saveJsonFile()
             s[i]->writeFloatArray("pageExtent", &lastDoc->getPageRectW().xmin, 4);
             s[i]->writeFloat("viewScale", lastDoc->getViewScale());
         }
-        if (flags[i] != 0) {
+        if (flags[i] != 0 && bs[i] && forUndo()) {
+            ret = s[i]->writeNode("record", -1, true);
+            bs[i]->swapData(data[i]);
+        }
+        else if (flags[i] != 0) {
             filename = getFileName(i > 0);
-            FILE *fp = mgopenfile(filename.c_str(), "wt");
-            
-            if (!fp) {
-                LOGE("Fail to save file: %s", filename.c_str());
-            } else {
-                ret = s[i]->writeNode("record", -1, true) && js[i]->save(fp, VG_PRETTY);
-                fclose(fp);
-                if (!ret) {
-                    LOGE("Fail to record shapes: %s", filename.c_str());
-                }
+            ret = s[i]->writeNode("record", -1, true) && saveFile(filename, js[i], bs[i]);
+            if (!ret) {
+                LOGE("Fail to record shapes: %s", filename.c_str());
             }
         }
         delete js[i];
+        delete bs[i];
         js[i] = NULL;
+        bs[i] = NULL;
         s[i] = NULL;
     }
     if (ret) {
@@ -493,6 +783,9 @@ bool MgRecordShapes::Impl::saveJsonFile()
             LOGD("Record %03d: tick=%d, flags=%d, count=%d, filesize=%ld",
                  fileCount, tick, flags[0], shapeCount, (long)stat1.st_size);
         }*/
+        if (forUndo()) {
+            pushStep(data);
+        }
         maxCount = ++fileCount;
         lastTick = tick;
     }
@@ -500,37 +793,343 @@ bool MgRecordShapes::Impl::saveJsonFile()
     return ret;
 }
 
-bool MgRecordShapes::Impl::saveIndexFile(bool ended)
+void MgRecordShapes::Impl::pushStep(std::vector<unsigned char>* data)
 {
-    std::string filename(path + "records.json");
-    FILE *fp = mgopenfile(filename.c_str(), "wt");
+    GiMutex::Lock lock(stepsLock);
+    
+    while (!steps.empty() && steps.back().index >= fileCount) {    // 丢弃原来可重做的步骤
+        memBytes -= steps.back().bytes();
+        steps.pop_back();
+    }
+    
+    steps.push_back(MgUndoStep());
+    MgUndoStep& step = steps.back();
+    
+    step.index = fileCount;
+    step.data[0].swap(data[0]);
+    step.data[1].swap(data[1]);
+    memBytes += step.bytes();
+    
+    while (memBytes > budget && !steps.empty()) {
+        spillStep();
+    }
+}
+
+void MgRecordShapes::Impl::spillStep()
+{
+    const MgUndoStep& step = steps.front();
+    
+    for (int i = 0; i < 2; i++) {
+        std::string filename(getFileName(i > 0, step.index));
+        
+        if (step.data[i].empty()) {             // 去掉以前留下的同名文件
+            remove(filename.c_str());
+            continue;
+        }
+        
+        FILE *fp = mgopenfile(filename.c_str(), "wb");
+        if (!fp || fwrite(&step.data[i].front(), 1, step.data[i].size(), fp) != step.data[i].size()) {
+            LOGE("Fail to save file: %s", filename.c_str());
+        }
+        if (fp) {
+            fclose(fp);
+        }
+    }
+    memBytes -= step.bytes();
+    steps.pop_front();
+}
+
+const MgUndoStep* MgRecordShapes::Impl::findStep(int index) const
+{
+    for (std::deque<MgUndoStep>::const_reverse_iterator it = steps.rbegin(); it != steps.rend(); ++it) {
+        if (it->index == index)
+            return &*it;
+        if (it->index < index)
+            break;
+    }
+    return NULL;
+}
+
+void MgRecordShapes::Impl::saveFrameIndex()
+{
+    int index = fileCount - 2;                  // 帧文件 N.vgr 对应第 N-1 条记录
+    
+    if (!frames->isCreated()) {
+        std::string filename(path + MgRecordIndex::fileName());
+        if (!frames->create(filename.c_str(), index)) {
+            return;
+        }
+    }
+    if (!frames->write(index, tick, flags[0], keyframe)) {
+        LOGE("Fail to write frame index %d", index);
+    }
+    if (fileCount % 10 == 0 || flags[0] != MgRecordShapes::DYN) {
+        frames->flush();
+        if (pack) {
+            pack->flush();
+        }
+    }
+}
+
+bool MgRecordShapes::Impl::saveFile(const std::string& filename, MgJsonStorage* js, MgBinStorage* bs)
+{
+    if (pack) {                                 // 追加到容器文件，文件名去掉目录作为段名
+        const char* name = filename.c_str() + path.size();
+        const char* str = bs ? NULL : js->stringify(VG_PRETTY);
+        int size = bs ? bs->getSize() : (int)strlen(str);
+        
+        deltaBytes += size;
+        return bs ? pack->write(name, bs->getData(), size) : pack->write(name, str, size);
+    }
+    
+    FILE *fp = mgopenfile(filename.c_str(), bs ? "wb" : "wt");
     bool ret = false;
     
     if (!fp) {
         LOGE("Fail to save file: %s", filename.c_str());
     } else {
-        if (ended) {
-            s[2]->writeNode("records", -1, true);
+        ret = bs ? bs->save(fp) : js->save(fp, VG_PRETTY);
+        deltaBytes += (int)ftell(fp);
+        fclose(fp);
+    }
+    
+    return ret;
+}
+
+void MgRecordShapes::Impl::openPack()
+{
+    std::string packfile(path + MgRecordPack::fileName());
+    
+    pack = new MgRecordPack();
+    if (!pack->open(packfile.c_str())) {
+        delete pack;
+        pack = NULL;
+    }
+}
+
+MgStorage* MgRecordShapes::Impl::readPacked(const std::string& filename,
+                                            MgJsonStorage& js, MgBinStorage& bs) const
+{
+    int size = 0;
+    const unsigned char* data = pack ? pack->find(filename.c_str() + path.size(), size) : NULL;
+    
+    if (!data) {
+        return NULL;
+    }
+    if (MgBinStorage::isBinary(data, size)) {
+        return bs.storageForRead(data, size);   // 直接读映射的内容
+    }
+    
+    std::string content((const char*)data, size);
+    return js.storageForRead(content.c_str());
+}
+
+void MgRecordShapes::Impl::saveKeyframe()
+{
+    int index = fileCount - 1;
+    
+    if (!lastDoc || (index - keyframe < keyFrames && deltaBytes < keyBytes)) {
+        return;
+    }
+    
+    std::stringstream ss;
+    ss << path << index << ".vgk";
+    
+    std::string filename(ss.str());
+    MgJsonStorage js;
+    MgBinStorage bs;
+    bool ret;
+    
+    bs.setPrecision(precision);                 // 关键帧为完整的图形文档
+    if (binary) {
+        ret = lastDoc->save(bs.storageForWrite(), 0) && saveFile(filename, NULL, &bs);
+    } else {
+        ret = lastDoc->save(js.storageForWrite(), 0) && saveFile(filename, &js, NULL);
+    }
+    if (ret) {
+        keyframe = index;
+        deltaBytes = 0;
+    }
+}
+
+bool MgRecordShapes::Impl::loadKeyframe(MgShapeFactory *f, MgShapeDoc* doc, int index)
+{
+    std::stringstream ss;
+    ss << path << index << (index > 0 ? ".vgk" : ".vg");
+    
+    std::string filename(ss.str());
+    MgJsonStorage js;
+    MgBinStorage bs;
+    MgStorage* s = readPacked(filename, js, bs);
+    
+    if (s) {
+        return doc->load(f, s, false);
+    }
+    
+    FILE *fp = mgopenfile(filename.c_str(), "rb");
+    
+    if (!fp) {
+        LOGE("Fail to read file: %s", filename.c_str());
+        return false;
+    }
+    s = (MgBinStorage::isBinaryFile(fp) ? bs.storageForRead(fp) : js.storageForRead(fp));
+    fclose(fp);
+    
+    return doc->load(f, s, false);
+}
+
+bool MgRecordShapes::startPrefetch(MgShapeFactory *f, MgShapeDoc* doc, int maxBytes)
+{
+    if (!isPlaying() || !f || _im->prefetcher.isStarted())
+        return false;
+    
+    _im->factory = f;
+    _im->layerIndex = doc ? doc->getCurrentLayer()->getIndex() : 0;
+    _im->prefetchBytes = maxBytes;
+    _im->prefetchIndex = mgMax(1, (int)_im->fileCount);
+    return _im->prefetcher.start(prefetchProc, this);
+}
+
+void MgRecordShapes::stopPrefetch()
+{
+    _im->stopPrefetch();
+}
+
+void MgRecordShapes::prefetchProc(void* param)
+{
+    Impl* im = ((MgRecordShapes*)param)->_im;
+    MgFrameItem item;
+    
+    while (!im->prefetchStop) {
+        if (im->ready.full() || im->bytesAhead >= im->prefetchBytes) {
+            giSleep(2);                         // 等主线程取走
         }
-        ret = js[2]->save(fp, VG_PRETTY);
-        if (!ret) {
-            LOGE("Fail to save records: %s", filename.c_str());
+        else if (!im->parseFrame(im->prefetchIndex, item)) {
+            giSleep(10);                        // 帧文件可能还没写出
         }
+        else {
+            Impl::addBytes(im->bytesAhead, item.bytes);
+            im->ready.push(item);
+            im->prefetchIndex++;
+        }
+    }
+}
+
+bool MgRecordShapes::Impl::parseFrame(int index, MgFrameItem& item)
+{
+    std::string filename(getFileName(false, index));
+    double t = giTickCount();
+    MgJsonStorage js;
+    MgBinStorage bs;
+    MgStorage* s = NULL;
+    
+    if (pack && pack->find(filename.c_str() + path.size(), item.bytes)) {
+        s = readPacked(filename, js, bs);
+    } else {
+        FILE *fp = mgopenfile(filename.c_str(), "rb");
+        
+        if (!fp)
+            return false;
+        
+        fseek(fp, 0, SEEK_END);
+        item.bytes = (int)ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        s = (MgBinStorage::isBinaryFile(fp) ? bs.storageForRead(fp) : js.storageForRead(fp));
         fclose(fp);
     }
     
-    return ret;
+    item.index = index;
+    item.frame = new MgRecordFrame();
+    if (!readFrame(factory, s, *item.frame, NULL, layerIndex, -1)) {   // 播放的动态图形列表由 MgShapes::create() 创建
+        LOGE("Fail to prefetch frame %d", index);
+        delete item.frame;                      // 仍放入队列，以免预读停在此帧
+        item.frame = NULL;
+    }
+    item.parseTime = (float)(giTickCount() - t);
+    
+    return true;
+}
+
+bool MgRecordShapes::Impl::takeFrame(int index, MgFrameItem& item)
+{
+    for (;;) {
+        if (!held.index && !ready.pop(held))
+            return false;
+        if (held.index == index) {
+            item = held;
+            memset(&held, 0, sizeof(held));
+            addBytes(bytesAhead, -item.bytes);
+            return item.frame != NULL;          // 预读失败的帧由调用者同步读取
+        }
+        if (held.index > index)                 // 还未播放到
+            return false;
+        addBytes(bytesAhead, -held.bytes);      // 已跳过的帧
+        held.free();
+    }
+}
+
+void MgRecordShapes::Impl::stopPrefetch()
+{
+    MgFrameItem item;
+    
+    if (prefetcher.isStarted()) {
+        giAtomicIncrement(&prefetchStop);
+        prefetcher.join();
+        prefetchStop = 0;
+    }
+    held.free();
+    while (ready.pop(item)) {
+        item.free();
+    }
+    bytesAhead = 0;
+}
+
+int MgRecordShapes::getFramesAhead() const
+{
+    return _im->ready.size() + (_im->held.index ? 1 : 0);
+}
+
+int MgRecordShapes::getBytesAhead() const
+{
+    return (int)_im->bytesAhead;
+}
+
+float MgRecordShapes::getParseTime() const
+{
+    return _im->appliedCount > 0 ? (float)(_im->parseTotal / _im->appliedCount) : 0.f;
+}
+
+float MgRecordShapes::getApplyTime() const
+{
+    return _im->appliedCount > 0 ? (float)(_im->applyTotal / _im->appliedCount) : 0.f;
+}
+
+void MgRecordShapes::Impl::stopWriter()
+{
+    if (writer.isStarted()) {
+        giAtomicIncrement(&stopping);
+        queued.signal();
+        writer.join();                          // 写完队列中的帧
+        stopping = 0;
+    }
 }
 
 void MgRecordShapes::Impl::stopRecordIndex()
 {
-    if (js[2]) {
-        if (fileCount > 1 && saveIndexFile(true)) {
-            LOGD("Save records.json in %s", path.c_str());
+    stopWriter();
+    stopPrefetch();
+    if (pack && pack->isCreated()) {
+        pack->close();
+    }
+    if (frames && frames->isCreated()) {
+        frames->close();
+        LOGD("Save %s in %s", MgRecordIndex::fileName(), path.c_str());
+    }
+    if (spillOnStop) {                          // 写出内存中的撤销步骤，以便恢复
+        GiMutex::Lock lock(stepsLock);
+        while (!steps.empty()) {
+            spillStep();
         }
-        delete js[2];
-        js[2] = NULL;
-        s[2] = NULL;
     }
     MgObject::release_pointer(lastShape);
 }
@@ -539,80 +1138,293 @@ int MgRecordShapes::applyFile(int& tick, MgShapeFactory *f,
                               MgShapeDoc* doc, MgShapes* dyns, const char* fn,
                               long* changeCount, MgShape* lastShape)
 {
-    FILE *fp = mgopenfile(fn, "rt");
+    FILE *fp = mgopenfile(fn, "rb");
     if (!fp) {
         //LOGE("Fail to read file: %s", fn);
         return 0;
     }
     
     MgJsonStorage js;
-    MgStorage* s = js.storageForRead(fp);
-    int ret = 0;
+    MgBinStorage bs;
+    MgStorage* s = (MgBinStorage::isBinaryFile(fp) ? bs.storageForRead(fp)
+                    : js.storageForRead(fp));
     
     fclose(fp);
-    if (s->readNode("record", -1, false)) {
-        if (doc) {
-            if (s->readFloatArray("transform", &doc->modelTransform().m11, 6, false) == 6) {
-                Box2d rect(doc->getPageRectW());
-                s->readFloatArray("pageExtent", &rect.xmin, 4);
-                float viewScale = s->readFloat("viewScale", doc->getViewScale());
-                doc->setPageRectW(rect, viewScale);
+    return applyStorage(tick, f, doc, dyns, s, changeCount, lastShape);
+}
+
+int MgRecordShapes::applyStep(bool back, int index, MgShapeFactory *f, MgShapeDoc* doc,
+                              MgShapes* dyns, long* changeCount, MgShape* lastShape)
+{
+    {
+        GiMutex::Lock lock(_im->stepsLock);     // 录制线程可能正在加入或写出步骤
+        const MgUndoStep* step = _im->findStep(index);
+        
+        if (step) {
+            const std::vector<unsigned char>& data = step->data[back ? 1 : 0];
+            MgBinStorage bs;
+            
+            return data.empty() ? 0 : applyStorage(_im->tick, f, doc, dyns,
+                                                   bs.storageForRead(&data.front(), (int)data.size()),
+                                                   changeCount, lastShape);
+        }
+    }
+    
+    std::string filename(_im->getFileName(back, index));    // 已写出到文件的步骤
+    MgJsonStorage js;
+    MgBinStorage bs;
+    MgStorage* s = _im->readPacked(filename, js, bs);
+    
+    if (s) {
+        return applyStorage(_im->tick, f, doc, dyns, s, changeCount, lastShape);
+    }
+    return applyFile(_im->tick, f, doc, dyns, filename.c_str(), changeCount, lastShape);
+}
+
+int MgRecordShapes::applyStorage(int& tick, MgShapeFactory *f,
+                                 MgShapeDoc* doc, MgShapes* dyns, MgStorage* s,
+                                 long* changeCount, MgShape* lastShape)
+{
+    MgRecordFrame frame;
+    MgShapes* layer = doc ? doc->getCurrentLayer() : NULL;
+    
+    if (!Impl::readFrame(f, s, frame, layer, layer ? layer->getIndex() : SKIP_LAYER,
+                         dyns ? dyns->getIndex() : SKIP_LAYER)) {
+        return 0;
+    }
+    return Impl::applyFrame(tick, doc, dyns, frame, changeCount, lastShape);
+}
+
+bool MgRecordShapes::Impl::readFrame(MgShapeFactory *f, MgStorage* s, MgRecordFrame& frame,
+                                     MgShapes* layer, int layerIndex, int dynIndex)
+{
+    if (!s || !s->readNode("record", -1, false)) {
+        return false;
+    }
+    if (layerIndex != SKIP_LAYER) {
+        if (s->readFloatArray("transform", &frame.transform.m11, 6, false) == 6) {
+            frame.viewChanged = true;
+            frame.extentCount = s->readFloatArray("pageExtent", &frame.pageExtent.xmin, 4);
+            frame.viewScale = s->readFloat("viewScale", 0);
+        }
+        
+        frame.flags = s->readInt("flags", 0);
+        if ((frame.flags & (ADD|EDIT)) && layer) {  // 在主线程中直接读入图层
+            frame.loaded = layer->load(f, s, true);
+        } else if (frame.flags & (ADD|EDIT)) {      // 预读时图形在此创建，不占用主线程
+            frame.shapes = MgLayer::create(NULL, layerIndex);   // 无所属文档时也保留图层序号
+            frame.loaded = frame.shapes->load(f, s, true);
+        }
+        
+        if (s->readNode("delete", -1, false)) {
+            char key[16];
+            for (int i = 0; ; i++) {
+                int sid = s->readInt(deletedKey(key, i), 0);
+                if (sid == 0)
+                    break;
+                frame.deleted.push_back(sid);
+            }
+            s->readNode("delete", -1, true);
+        }
+    }
+    if (dynIndex != SKIP_LAYER && s->readNode("dynamic", -1, false)) {
+        frame.dynShapes = MgLayer::create(NULL, dynIndex);
+        frame.dynLoaded = frame.dynShapes->load(f, s);
+        s->readNode("dynamic", -1, true);
+    } else if (dynIndex != SKIP_LAYER) {
+        int n = s->readFloatArray("dyninc", NULL, 0);
+        
+        if (n > 0) {
+            frame.dyninc.resize(n);
+            if (s->readFloatArray("dyninc", &frame.dyninc.front(), n) != n)
+                frame.dyninc.clear();
+        }
+    }
+    frame.tick = s->readInt("tick", -1);
+    frame.changeCount = s->readInt("changeCount", -1);
+    
+    s->readNode("record", -1, true);
+    return true;
+}
+
+int MgRecordShapes::Impl::applyFrame(int& tick, MgShapeDoc* doc, MgShapes* dyns,
+                                     MgRecordFrame& frame, long* changeCount, MgShape* lastShape)
+{
+    int ret = 0;
+    
+    if (doc) {
+        if (frame.viewChanged) {
+            Box2d rect(frame.extentCount == 4 ? frame.pageExtent : doc->getPageRectW());
+            doc->modelTransform() = frame.transform;
+            doc->setPageRectW(rect, frame.viewScale > 0 ? frame.viewScale : doc->getViewScale());
+        }
+        
+        MgShapes* stds = doc->getCurrentLayer();
+        
+        if (frame.shapes) {                         // 直接移入已创建好的图形
+            frame.shapes->moveShapesTo(stds);
+        }
+        if (frame.loaded > 0) {
+            ret |= (frame.flags == ADD) ? SHAPE_APPEND : DOC_CHANGED;
+        }
+        for (unsigned i = 0; i < frame.deleted.size(); i++) {
+            if (stds->removeShape(frame.deleted[i])) {
+                ret |= DOC_CHANGED;
+                //LOGD("removeShape id=%d", frame.deleted[i]);
             }
+        }
+    }
+    if (dyns && frame.dynShapes) {
+        if (frame.dynLoaded >= 0) {
+            dyns->clear();
+            frame.dynShapes->moveShapesTo(dyns);
+            ret |= DYN_CHANGED;
+        }
+    } else if (dyns && lastShape && !frame.dyninc.empty()
+               && lastShape->shapec()->isKindOf(MgBaseLines::Type())) {
+        MgShape* sp = lastShape->cloneShape();
+        MgBaseLines* lines = (MgBaseLines*)sp->shape();
+        
+        for (unsigned i = 0; i + 1 < frame.dyninc.size(); i += 2) {
+            lines->addPoint(Point2d(frame.dyninc[i], frame.dyninc[i + 1]));
+        }
+        lines->update();
+        dyns->addShapeDirect(sp, true);
+        ret |= DYN_CHANGED;
+    }
+    if (ret && frame.tick >= 0) {
+        tick = frame.tick;
+    }
+    if (ret && changeCount && frame.changeCount >= 0) {
+        *changeCount = frame.changeCount;
+    }
+    
+    return ret;
+}
+
+bool MgRecordShapes::convertFile(const char* srcfile, const char* destfile,
+                                 bool binary, float precision)
+{
+    FILE *fp = mgopenfile(srcfile, "rb");
+    if (!fp) {
+        return false;
+    }
+    
+    MgJsonStorage js, jsout;
+    MgBinStorage bs, bsout;
+    bool isbin = MgBinStorage::isBinaryFile(fp);
+    
+    if (isbin) {
+        bs.storageForRead(fp);
+    } else {
+        js.storageForRead(fp);
+    }
+    fclose(fp);
+    
+    bsout.setPrecision(precision);
+    MgStorage* s = binary ? bsout.storageForWrite() : jsout.storageForWrite();
+    bool ret = isbin ? bs.copyTo(s) : js.copyTo(s);
+    
+    if (ret) {
+        fp = mgopenfile(destfile, binary ? "wb" : "wt");
+        ret = fp && (binary ? bsout.save(fp) : jsout.save(fp, VG_PRETTY));
+        if (fp) {
+            fclose(fp);
+        }
+    }
+    if (!ret) {
+        LOGE("Fail to convert %s to %s", srcfile, destfile);
+    }
+    
+    return ret;
+}
+
+int MgRecordShapes::convertRecords(const char* path, bool binary, float precision)
+{
+    std::vector<int> arr;
+    int count = 0;
+    
+    if (!path || !loadFrameIndex(path, arr)) {
+        return 0;
+    }
+    
+    std::string prefix(path);
+    if (*prefix.rbegin() != '/' && *prefix.rbegin() != '\\') {
+        prefix += '/';
+    }
+    for (unsigned i = 0; i + 2 < arr.size(); i += 3) {
+        for (int back = 0; back < 2; back++) {
+            std::stringstream ss;
+            ss << prefix << arr[i] << (back ? ".vgu" : ".vgr");
             
-            MgShapes* stds = doc->getCurrentLayer();
-            int flags = s->readInt("flags", 0);
+            std::string fn(ss.str());
+            FILE *fp = mgopenfile(fn.c_str(), "rb");
             
-            if ((flags & (ADD|EDIT)) && stds->load(f, s, true) > 0) {
-                ret |= (flags == ADD) ? SHAPE_APPEND : DOC_CHANGED;
+            if (fp) {                           // 只记录变化的帧没有 .vgu 文件
+                fclose(fp);
+                count += convertFile(fn.c_str(), fn.c_str(), binary, precision) ? 1 : 0;
             }
+        }
+    }
+    LOGD("Convert %d files in %s", count, path);
+    
+    return count;
+}
+
+int MgRecordShapes::packRecords(const char* path, bool removeFiles)
+{
+    static const char* const exts[] = { ".vgr", ".vgu", ".vgk" };
+    std::vector<int> arr;
+    std::vector<std::string> packed;
+    std::vector<unsigned char> data;
+    MgRecordPack pack;
+    
+    if (!path || !loadFrameIndex(path, arr)) {
+        return 0;
+    }
+    
+    std::string prefix(path);
+    if (*prefix.rbegin() != '/' && *prefix.rbegin() != '\\') {
+        prefix += '/';
+    }
+    std::string packfile(prefix + MgRecordPack::fileName());
+    if (!pack.create(packfile.c_str())) {
+        return 0;
+    }
+    for (unsigned i = 0; i + 2 < arr.size(); i += 3) {
+        for (int j = 0; j < 3; j++) {
+            std::stringstream ss;
+            ss << arr[i] << exts[j];
+            
+            std::string name(ss.str());
+            std::string fn(prefix + name);
+            FILE *fp = mgopenfile(fn.c_str(), "rb");
             
-            if (s->readNode("delete", -1, false)) {
-                for (int i = 0; ; i++) {
-                    std::stringstream ss;
-                    ss << "d" << i;
-                    int sid = s->readInt(ss.str().c_str(), 0);
-                    if (sid == 0)
-                        break;
-                    if (stds->removeShape(sid)) {
-                        ret |= DOC_CHANGED;
-                        //LOGD("removeShape id=%d", sid);
-                    }
-                }
-                s->readNode("delete", -1, true);
+            if (!fp) {                          // 只记录变化的帧没有 .vgu 文件
+                continue;
             }
-        }
-        if (dyns && s->readNode("dynamic", -1, false)) {
-            if (dyns->load(f, s) >= 0)
-                ret |= DYN_CHANGED;
-            s->readNode("dynamic", -1, true);
-        } else if (dyns && lastShape
-                   && lastShape->shapec()->isKindOf(MgBaseLines::Type())) {
-            int n = s->readFloatArray("dyninc", NULL, 0);
-            mgvector<float> buf(n);
+            fseek(fp, 0, SEEK_END);
+            data.resize(ftell(fp));
+            fseek(fp, 0, SEEK_SET);
+            bool ret = data.empty() || fread(&data.front(), 1, data.size(), fp) == data.size();
+            fclose(fp);
             
-            if (n > 0 && s->readFloatArray("dyninc", buf.address(), n) == n) {
-                MgShape* sp = lastShape->cloneShape();
-                MgBaseLines* lines = (MgBaseLines*)sp->shape();
-                
-                for (int i = 0; i + 1 < n; i += 2) {
-                    lines->addPoint(Point2d(buf.get(i), buf.get(i + 1)));
-                }
-                lines->update();
-                dyns->addShapeDirect(sp, true);
-                ret |= DYN_CHANGED;
+            if (ret && pack.write(name.c_str(), data.empty() ? NULL : &data.front(),
+                                  (int)data.size())) {
+                packed.push_back(fn);
             }
         }
-        if (ret) {
-            tick = s->readInt("tick", tick);
-        }
-        if (ret && changeCount) {
-            *changeCount = s->readInt("changeCount", (int)*changeCount);
+    }
+    pack.close();
+    
+    if (removeFiles) {                          // 写完容器文件再删除帧文件
+        for (unsigned i = 0; i < packed.size(); i++) {
+            remove(packed[i].c_str());
         }
-        
-        s->readNode("record", -1, true);
     }
+    LOGD("Pack %d files in %s", (int)packed.size(), path);
     
-    return ret;
+    return (int)packed.size();
 }
 
 bool MgRecordShapes::applyFirstFile(MgShapeFactory *factory, MgShapeDoc* doc)
@@ -644,8 +1456,24 @@ int MgRecordShapes::applyRedoFile(MgShapeFactory *f, MgShapeDoc* doc, MgShapes*
     if (index <= 0)
         index = _im->fileCount;
     
-    std::string filename(_im->getFileName(false, index));
-    int ret = applyFile(_im->tick, f, doc, dyns, filename.c_str(), NULL, _im->lastShape);
+    MgFrameItem item;
+    int ret;
+    bool prefetched = _im->takeFrame(index, item);
+    
+    if (prefetched && !item.frame->matches(doc, dyns)) {
+        item.free();                            // 图层已变，改为同步读取
+        prefetched = false;
+    }
+    if (prefetched) {                           // 使用预读线程已创建好图形的帧
+        double t = giTickCount();
+        ret = Impl::applyFrame(_im->tick, doc, dyns, *item.frame, NULL, _im->lastShape);
+        _im->applyTotal += giTickCount() - t;
+        _im->parseTotal += item.parseTime;
+        _im->appliedCount++;
+        item.free();
+    } else {
+        ret = applyStep(false, index, f, doc, dyns, NULL, _im->lastShape);
+    }
     
     if (ret) {
         _im->fileCount = index + 1;
@@ -659,6 +1487,57 @@ int MgRecordShapes::applyRedoFile(MgShapeFactory *f, MgShapeDoc* doc, MgShapes*
     return ret;
 }
 
+int MgRecordShapes::seekTo(MgShapeFactory *f, MgShapeDoc* doc, MgShapes* dyns, int tick)
+{
+    if (!_im->frames) {
+        _im->frames = new MgRecordIndex();
+    }
+    if (!_im->frames->isCreated() && _im->frames->getCount() == 0) {
+        std::string filename(_im->path + MgRecordIndex::fileName());
+        if (!_im->frames->open(filename.c_str())) {
+            return 0;
+        }
+    }
+    
+    MgRecordIndex* frames = _im->frames;
+    int r = frames->findFrame(tick);            // 第r条记录对应帧文件 r+1
+    int index = r + 1;
+    int key = r < 0 ? 0 : frames->getKeyframe(r);
+    
+    if (!_im->loadKeyframe(f, doc, key)) {
+        return 0;
+    }
+    for (int i = key + 1; i <= index; i++) {    // 只有动态图形的帧不影响文档
+        if (frames->getFlags(i - 1) != DYN) {
+            applyStep(false, i, f, doc, NULL);
+        }
+    }
+    
+    // 增量记录的动态图形(dyninc)依赖前一帧，从连续的动态帧之前的完整动态图形开始重放
+    int start = index;
+    while (start > 1 && frames->getFlags(start - 1) == DYN) {
+        start--;
+    }
+    MgObject::release_pointer(_im->lastShape);
+    for (int i = start; dyns && i > 0 && i <= index; i++) {
+        dyns->clear();
+        applyStep(false, i, f, NULL, dyns, NULL, _im->lastShape);
+        MgObject::release_pointer(_im->lastShape);
+        _im->lastShape = const_cast<MgShape*>(dyns->getLastShape());
+        if (_im->lastShape)
+            _im->lastShape->addRef();
+    }
+    _im->fileCount = index + 1;
+    _im->tick = r < 0 ? 0 : frames->getTick(r);
+    if (_im->prefetcher.isStarted()) {          // 从新位置预读
+        stopPrefetch();
+        startPrefetch(f, doc, _im->prefetchBytes);
+    }
+    LOGD("seekTo tick=%d, frame=%d, keyframe=%d", tick, index, key);
+    
+    return DOC_CHANGED | DYN_CHANGED;
+}
+
 int MgRecordShapes::applyUndoFile(MgShapeFactory *f, MgShapeDoc* doc,
                                   MgShapes* dyns, int index, long curTick)
 {
@@ -673,14 +1552,15 @@ int MgRecordShapes::applyUndoFile(MgShapeFactory *f, MgShapeDoc* doc,
         return DYN_CHANGED;
     }
     
-    std::string filename(_im->getFileName(true, index - 1));
-    int ret = applyFile(_im->tick, f, doc, NULL, filename.c_str());
-    
-    filename = _im->getFileName(false, index - 1);
-    ret |= applyFile(_im->tick, f, NULL, dyns, filename.c_str()) | DYN_CHANGED;
+    int ret = applyStep(true, index - 1, f, doc, NULL);
+    ret |= applyStep(false, index - 1, f, NULL, dyns) | DYN_CHANGED;
     
     if (ret) {
         _im->fileCount = index - 1;
+        if (_im->prefetcher.isStarted()) {
+            stopPrefetch();
+            startPrefetch(f, doc, _im->prefetchBytes);
+        }
         MgObject::release_pointer(_im->lastShape);
         if (dyns) {
             _im->lastShape = const_cast<MgShape*>(dyns->getLastShape());
@@ -0,0 +1,294 @@
+﻿// mgboxselector.cpp: 实现框选图形的辅助类 MgBoxSelector
+// Copyright (c) 2004-2013, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#include "mgboxselector.h"
+#include <set>
+
+struct MgBoxSelector::Impl
+{
+    struct Item {
+        const MgShape*  sp;
+        Box2d           extent;         // 图形的包络框
+        int             id;
+        int             stamp;          // 本次更新中已作为候选的标记
+        bool            selected;
+    };
+    enum { kMaxGrid = 256,              // 网格的最大行列数
+           kMaxCells = 16 };            // 包络框最多登记的网格数
+    
+    const MgShapes*     shapes;
+    long                journalId;
+    long                journalPos;
+    int                 count;
+    std::vector<Item>   items;          // 顶层图形，按图形列表中的次序
+    std::set<int>       selection;      // 选中的图形在 items 中的序号
+    
+    Box2d               grid;           // 网格范围
+    int                 nx, ny;         // 网格的列数和行数
+    float               cw, ch;         // 网格的宽和高
+    std::vector<int>    cellStart;      // 每个网格在 cellItems 中的起始位置
+    std::vector<int>    cellItems;      // 各网格中的图形序号
+    std::vector<int>    largeItems;     // 覆盖网格太多的图形
+    int                 stamp;
+    
+    Box2d               lastBox;        // 上一次的选择框
+    bool                hasBox;
+    bool                intersect;
+    
+    Impl() : shapes(NULL), journalId(0), journalPos(0), count(0)
+        , nx(0), ny(0), cw(0), ch(0), stamp(0), hasBox(false), intersect(false) {}
+    
+    bool isValid(const MgShapes* s) const;
+    void build(const MgShapes* s);
+    bool clearSelection();
+    void cellRange(const Box2d& rect, int& x1, int& y1, int& x2, int& y2) const;
+    void query(const Box2d& rect, std::vector<int>& orders);
+    bool check(int order, const Box2d& box);
+};
+
+// 闭区间相交判断，允许宽或高为零
+static bool overlaps(const Box2d& a, const Box2d& b)
+{
+    return a.xmin <= b.xmax && b.xmin <= a.xmax && a.ymin <= b.ymax && b.ymin <= a.ymax;
+}
+
+bool MgBoxSelector::Impl::isValid(const MgShapes* s) const
+{
+    long id = 0;
+    long pos = s ? s->getJournalPos(id) : 0;
+    return s && s == shapes && id == journalId && pos == journalPos
+        && s->getShapeCount() == count;
+}
+
+void MgBoxSelector::Impl::build(const MgShapes* s)
+{
+    MgShapeIterator it(s);
+    
+    shapes = s;
+    journalPos = s ? s->getJournalPos(journalId) : 0;
+    count = s ? s->getShapeCount() : 0;
+    items.clear();
+    selection.clear();
+    largeItems.clear();
+    hasBox = false;
+    
+    while (const MgShape* sp = it.getNext()) {
+        Item item;
+        item.sp = sp;
+        item.extent = sp->getExtent();
+        item.id = sp->getID();
+        item.stamp = stamp;
+        item.selected = false;
+        if (items.empty()) {
+            grid = item.extent;
+        }
+        else {                          // 不用 unionWith，以便包含宽或高为零的包络框
+            grid.set(mgMin(grid.xmin, item.extent.xmin), mgMin(grid.ymin, item.extent.ymin),
+                     mgMax(grid.xmax, item.extent.xmax), mgMax(grid.ymax, item.extent.ymax));
+        }
+        items.push_back(item);
+    }
+    
+    int n = (int)items.size();
+    int x1, y1, x2, y2, i, x, y;
+    
+    nx = ny = mgMax(1, mgMin((int)kMaxGrid, (int)sqrtf((float)n)));
+    cw = grid.width() > _MGZERO ? grid.width() / nx : 1.f;
+    ch = grid.height() > _MGZERO ? grid.height() / ny : 1.f;
+    cellStart.assign(nx * ny + 1, 0);
+    
+    for (i = 0; i < n; i++) {           // 统计每个网格中的图形数
+        cellRange(items[i].extent, x1, y1, x2, y2);
+        if ((x2 - x1 + 1) * (y2 - y1 + 1) > kMaxCells) {
+            largeItems.push_back(i);
+            continue;
+        }
+        for (y = y1; y <= y2; y++) {
+            for (x = x1; x <= x2; x++) {
+                cellStart[y * nx + x + 1]++;
+            }
+        }
+    }
+    for (i = 0; i < nx * ny; i++) {
+        cellStart[i + 1] += cellStart[i];
+    }
+    
+    std::vector<int> next(cellStart.begin(), cellStart.end() - 1);
+    std::vector<int>::const_iterator large = largeItems.begin();
+    
+    cellItems.resize(cellStart.back());
+    for (i = 0; i < n; i++) {           // 登记图形到其包络框覆盖的网格
+        if (large != largeItems.end() && *large == i) {
+            ++large;
+            continue;
+        }
+        cellRange(items[i].extent, x1, y1, x2, y2);
+        for (y = y1; y <= y2; y++) {
+            for (x = x1; x <= x2; x++) {
+                cellItems[next[y * nx + x]++] = i;
+            }
+        }
+    }
+}
+
+bool MgBoxSelector::Impl::clearSelection()
+{
+    bool changed = !selection.empty();
+    
+    for (std::set<int>::const_iterator it = selection.begin(); it != selection.end(); ++it) {
+        items[*it].selected = false;
+    }
+    selection.clear();
+    hasBox = false;
+    
+    return changed;
+}
+
+void MgBoxSelector::Impl::cellRange(const Box2d& rect, int& x1, int& y1, int& x2, int& y2) const
+{
+    x1 = mgMax(0, mgMin(nx - 1, (int)floorf((rect.xmin - grid.xmin) / cw)));
+    x2 = mgMax(0, mgMin(nx - 1, (int)floorf((rect.xmax - grid.xmin) / cw)));
+    y1 = mgMax(0, mgMin(ny - 1, (int)floorf((rect.ymin - grid.ymin) / ch)));
+    y2 = mgMax(0, mgMin(ny - 1, (int)floorf((rect.ymax - grid.ymin) / ch)));
+}
+
+void MgBoxSelector::Impl::query(const Box2d& rect, std::vector<int>& orders)
+{
+    int x1, y1, x2, y2, i;
+    
+    if (items.empty() || !overlaps(rect, grid)) {
+        return;
+    }
+    cellRange(rect, x1, y1, x2, y2);
+    
+    for (int y = y1; y <= y2; y++) {
+        for (int x = x1; x <= x2; x++) {
+            for (i = cellStart[y * nx + x]; i < cellStart[y * nx + x + 1]; i++) {
+                Item& item = items[cellItems[i]];
+                if (item.stamp != stamp && overlaps(item.extent, rect)) {
+                    item.stamp = stamp;
+                    orders.push_back(cellItems[i]);
+                }
+            }
+        }
+    }
+    for (i = 0; i < (int)largeItems.size(); i++) {
+        Item& item = items[largeItems[i]];
+        if (item.stamp != stamp && overlaps(item.extent, rect)) {
+            item.stamp = stamp;
+            orders.push_back(largeItems[i]);
+        }
+    }
+}
+
+bool MgBoxSelector::Impl::check(int order, const Box2d& box)
+{
+    Item& item = items[order];
+    bool sel = intersect ? item.sp->shapec()->hitTestBox(box) : box.contains(item.extent);
+    
+    if (sel == item.selected) {
+        return false;
+    }
+    item.selected = sel;
+    if (sel) {
+        selection.insert(order);
+    }
+    else {
+        selection.erase(order);
+    }
+    return true;
+}
+
+MgBoxSelector::MgBoxSelector() : _impl(new Impl())
+{
+}
+
+MgBoxSelector::~MgBoxSelector()
+{
+    delete _impl;
+}
+
+bool MgBoxSelector::update(const MgShapes* shapes, const Box2d& box, bool intersect)
+{
+    Impl* im = _impl;
+    bool changed = false;
+    
+    if (!im->isValid(shapes)) {
+        changed = !im->selection.empty();
+        im->build(shapes);
+    }
+    if (im->intersect != intersect) {
+        changed = im->clearSelection() || changed;
+        im->intersect = intersect;
+    }
+    
+    // 包络框不与前后两个选择框的差异区域相交的图形，其选中状态不变
+    std::vector<Box2d> rects;
+    
+    if (!im->hasBox) {
+        rects.push_back(box);
+    }
+    else {
+        const Box2d& old = im->lastBox;
+        float l = mgMax(old.xmin, box.xmin), r = mgMin(old.xmax, box.xmax);
+        float b = mgMax(old.ymin, box.ymin), t = mgMin(old.ymax, box.ymax);
+        
+        if (l < r && b < t) {           // 两框相交，取并集中除去交集后的四条边带
+            Box2d u(mgMin(old.xmin, box.xmin), mgMin(old.ymin, box.ymin),
+                    mgMax(old.xmax, box.xmax), mgMax(old.ymax, box.ymax));
+            if (u.xmin < l)
+                rects.push_back(Box2d(u.xmin, u.ymin, l, u.ymax));
+            if (r < u.xmax)
+                rects.push_back(Box2d(r, u.ymin, u.xmax, u.ymax));
+            if (u.ymin < b)
+                rects.push_back(Box2d(l, u.ymin, r, b));
+            if (t < u.ymax)
+                rects.push_back(Box2d(l, t, r, u.ymax));
+        }
+        else {
+            rects.push_back(old);
+            rects.push_back(box);
+        }
+    }
+    
+    std::vector<int> orders;
+    
+    im->stamp++;
+    for (size_t i = 0; i < rects.size(); i++) {
+        im->query(rects[i], orders);
+    }
+    for (size_t j = 0; j < orders.size(); j++) {
+        changed = im->check(orders[j], box) || changed;
+    }
+    im->lastBox = box;
+    im->hasBox = true;
+    
+    return changed;
+}
+
+void MgBoxSelector::getSelection(std::vector<int>& ids) const
+{
+    ids.clear();
+    ids.reserve(_impl->selection.size());
+    for (std::set<int>::const_iterator it = _impl->selection.begin();
+         it != _impl->selection.end(); ++it) {
+        ids.push_back(_impl->items[*it].id);
+    }
+}
+
+int MgBoxSelector::getSelectionCount() const
+{
+    return (int)_impl->selection.size();
+}
+
+void MgBoxSelector::reset()
+{
+    _impl->shapes = NULL;
+    _impl->items.clear();
+    _impl->selection.clear();
+    _impl->cellStart.clear();
+    _impl->cellItems.clear();
+    _impl->largeItems.clear();
+    _impl->hasBox = false;
+}
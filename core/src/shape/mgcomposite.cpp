@@ -3,14 +3,120 @@
 // License: LGPL, https://github.com/rhcad/touchvg
 
 #include "mgcomposite.h"
+#include "gilock.h"
+#include <algorithm>
 
-MgComposite::MgComposite() : _owner(NULL)
+static const int kIndexMinCount = 32;   // 子图形数达到此值才建立索引
+static const int kLeafCount = 8;        // 索引叶节点最多的子图形数
+
+//! 子图形的包络框层次索引
+struct MgComposite::Index
+{
+    struct Node {
+        Box2d   box;        // 本节点下各子图形的包络框
+        int     first;      // 叶节点在 items 中的起始位置，内部节点为-1
+        int     count;      // 叶节点的子图形数，内部节点为右子节点序号(左子节点紧随其后)
+    };
+    struct Item {
+        Box2d   box;
+        Point2d center;
+        int     order;      // 子图形的显示次序
+    };
+    struct Less {
+        bool    byx;
+        Less(bool x) : byx(x) {}
+        bool operator()(const Item& a, const Item& b) const {
+            return byx ? a.center.x < b.center.x : a.center.y < b.center.y;
+        }
+    };
+    
+    std::vector<const MgShape*> shapes;     // 按显示次序排列的子图形
+    std::vector<Item>   items;
+    std::vector<Node>   nodes;
+    
+    Index(const MgShapes* list) {
+        MgShapeIterator it(list);
+        
+        while (const MgShape* sp = it.getNext()) {
+            Item item;
+            item.box = sp->getExtent();
+            item.center = item.box.center();
+            item.order = (int)shapes.size();
+            items.push_back(item);
+            shapes.push_back(sp);
+        }
+        nodes.reserve(items.size() * 2 / kLeafCount + 1);
+        build(0, (int)items.size());
+    }
+    
+    int build(int first, int count) {
+        int index = (int)nodes.size();
+        Node node;
+        
+        node.box = items[first].box;        // 不用 unionWith，以免丢弃宽或高为零的范围
+        for (int i = first + 1; i < first + count; i++) {
+            const Box2d& rect = items[i].box;
+            node.box.xmin = mgMin(node.box.xmin, rect.xmin);
+            node.box.ymin = mgMin(node.box.ymin, rect.ymin);
+            node.box.xmax = mgMax(node.box.xmax, rect.xmax);
+            node.box.ymax = mgMax(node.box.ymax, rect.ymax);
+        }
+        node.first = first;
+        node.count = count;
+        nodes.push_back(node);
+        
+        if (count > kLeafCount) {           // 沿长边按中心点对半划分
+            int half = count / 2;
+            std::vector<Item>::iterator it = items.begin() + first;
+            
+            std::nth_element(it, it + half, it + count,
+                             Less(node.box.width() >= node.box.height()));
+            build(first, half);
+            nodes[index].first = -1;
+            nodes[index].count = build(first + half, count - half);
+        }
+        
+        return index;
+    }
+    
+    void find(const Box2d& box, std::vector<const MgShape*>& result) const {
+        std::vector<int> orders;
+        std::vector<int> stack(1, 0);
+        
+        while (!stack.empty()) {
+            const Node& node = nodes[stack.back()];
+            int index = stack.back();
+            
+            stack.pop_back();
+            if (!node.box.isIntersect(box)) {
+                continue;
+            }
+            if (node.first < 0) {
+                stack.push_back(node.count);
+                stack.push_back(index + 1);
+                continue;
+            }
+            for (int i = node.first; i < node.first + node.count; i++) {
+                if (items[i].box.isIntersect(box)) {
+                    orders.push_back(items[i].order);
+                }
+            }
+        }
+        std::sort(orders.begin(), orders.end());
+        for (size_t i = 0; i < orders.size(); i++) {
+            result.push_back(shapes[orders[i]]);
+        }
+    }
+};
+
+MgComposite::MgComposite() : _owner(NULL), _index(NULL), _indexDirty(0)
 {
     _shapes = MgShapes::create(this);
 }
 
 MgComposite::~MgComposite()
 { 
+    delete _index;
     _shapes->release();
 }
 
@@ -24,6 +130,64 @@ void MgComposite::setOwner(MgShape* owner)
     _owner = owner;
 }
 
+void MgComposite::childChanged(const MgShape* sp, bool grown)
+{
+    Box2d old(_extent);
+    
+    if (grown && sp) {
+        _extent.unionWith(sp->getExtent());
+    } else {
+        _extent = _shapes->getExtent();
+    }
+    invalidateIndex();                      // 连续增删改时不逐个重建，下次查找时重建
+    
+    MgShapes* parent = _owner ? _owner->getParent() : NULL;
+    MgObject* owner = parent ? parent->getOwner() : NULL;
+    
+    if (old != _extent && owner && owner->isKindOf(Type())
+        && ((MgComposite*)owner)->shapes() == parent) {
+        ((MgComposite*)owner)->childChanged(_owner, _extent.contains(old));
+    }
+}
+
+void MgComposite::rebuildIndex()
+{
+    delete _index;
+    _index = NULL;
+    _indexDirty = 0;
+    if (_shapes->getShapeCount() >= kIndexMinCount) {
+        _index = new Index(_shapes);
+    }
+}
+
+void MgComposite::invalidateIndex()
+{
+    delete _index;
+    _index = NULL;
+    _indexDirty = 1;
+}
+
+bool MgComposite::findChildren(const Box2d& box, std::vector<const MgShape*>& shapes) const
+{
+    if (_indexDirty && giAtomicCompareAndSwap(&_indexDirty, 0, 1)) {
+        Index* index = NULL;                // 本线程负责重建，其他线程此时逐个检查
+        
+        if (_shapes->getShapeCount() >= kIndexMinCount) {
+            index = new Index(_shapes);
+        }
+        giMemoryBarrier();                  // 建好后再发布
+        _index = index;
+    }
+    
+    const Index* index = _index;
+    
+    if (!index || box.contains(index->nodes[0].box)) {
+        return false;                       // 全部可见时逐个检查更快
+    }
+    index->find(box, shapes);
+    return true;
+}
+
 int MgComposite::_getPointCount() const
 {
     const MgShape* sp = _shapes->getHeadShape();
@@ -125,6 +289,7 @@ void MgComposite::_update()
         _extent.unionWith(sp->shapec()->getExtent());
     }
     __super::_update();
+    invalidateIndex();
 }
 
 void MgComposite::_transform(const Matrix2d& mat)
@@ -133,11 +298,13 @@ void MgComposite::_transform(const Matrix2d& mat)
     while (MgShape* sp = const_cast<MgShape*>(it.getNext())) {
         sp->shape()->transform(mat);
     }
+    invalidateIndex();
 }
 
 void MgComposite::_clear()
 {
     _shapes->clear();
+    invalidateIndex();
     MgBaseShape::_clear();
 }
 
@@ -145,6 +312,7 @@ void MgComposite::_copy(const MgComposite& src)
 {
     _shapes->copyShapes(src._shapes);
     __super::_copy(src);
+    invalidateIndex();
 }
 
 bool MgComposite::_equals(const MgComposite& src) const
@@ -157,11 +325,15 @@ float MgComposite::_hitTest(const Point2d& pt, float tol, MgHitResult& res) cons
     MgShapeIterator it(_shapes);
     MgHitResult tmpRes;
     Box2d limits(pt, 2 * tol, 0);
+    std::vector<const MgShape*> shapes;
+    bool indexed = findChildren(limits, shapes);
+    size_t i = 0;
 
     res.segment = 0;
     res.dist = _FLT_MAX;
 
-    while (const MgShape* sp = it.getNext()) {
+    while (const MgShape* sp = indexed ? (i < shapes.size() ? shapes[i++] : NULL)
+           : it.getNext()) {
         if (limits.isIntersect(sp->shapec()->getExtent())) {
             float d = sp->shapec()->hitTest(pt, tol, tmpRes);
             if (res.dist > d - _MGZERO)
@@ -184,6 +356,7 @@ bool MgComposite::_offset(const Vector2d& vec, int)
     while (MgShape* sp = const_cast<MgShape*>(it.getNext())) {
         n += sp->shape()->offset(vec, -1) ? 1 : 0;
     }
+    invalidateIndex();
 
     return n > 0;
 }
@@ -191,10 +364,17 @@ bool MgComposite::_offset(const Vector2d& vec, int)
 bool MgComposite::_draw(int mode, GiGraphics& gs, const GiContext& ctx, int) const
 {
     MgShapeIterator it(_shapes);
+    Box2d clip(gs.getClipModel());
+    std::vector<const MgShape*> shapes;
+    bool indexed = findChildren(clip, shapes);
+    size_t i = 0;
     int n = 0;
 
-    while (const MgShape* sp = it.getNext()) {
-        n += sp->draw(mode, gs, ctx.isNullLine() ? NULL : &ctx, -1) ? 1 : 0;
+    while (const MgShape* sp = indexed ? (i < shapes.size() ? shapes[i++] : NULL)
+           : it.getNext()) {
+        if (sp->getExtent().isIntersect(clip)) {    // 跳过显示区域外的子图形
+            n += sp->draw(mode, gs, ctx.isNullLine() ? NULL : &ctx, -1) ? 1 : 0;
+        }
     }
 
     return n > 0;
@@ -239,7 +419,9 @@ bool MgGroup::_save(MgStorage* s) const
 
 bool MgGroup::_load(MgShapeFactory* factory, MgStorage* s)
 {
-    return __super::_load(factory, s) && _shapes->load(factory, s) > 0;
+    bool ret = __super::_load(factory, s) && _shapes->load(factory, s) > 0;
+    rebuildIndex();
+    return ret;
 }
 
 bool MgGroup::addShapeToGroup(const MgShape* shape)
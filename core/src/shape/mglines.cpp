@@ -4,6 +4,7 @@
 
 #include "mgbasicsp.h"
 #include "mgshape_.h"
+#include <string.h>
 
 // MgBaseLines
 //
@@ -67,6 +68,8 @@ bool MgBaseLines::isIncrementFrom(const MgBaseLines& src) const
 {
     if (_count <= src._count)
         return false;
+    if (src._count > 0 && memcmp(_points, src._points, src._count * sizeof(Point2d)) == 0)
+        return true;    // 顶点复制而来时不必逐点计算距离
     
     for (int i = 0; i < src._count; i++) {
         if (!_points[i].isEqualTo(src._points[i], minTol()))
@@ -165,6 +168,19 @@ bool MgBaseLines::removePoint(int index)
     return ret;
 }
 
+int MgBaseLines::simplify(float tol)
+{
+    int n = mglnrel::simplifyLines(_count, _points, tol);
+    int removed = _count - n;
+    
+    if (removed > 0) {
+        _count = n;
+        update();
+    }
+    
+    return removed;
+}
+
 bool MgBaseLines::_setHandlePoint(int index, const Point2d& pt, float tol)
 {
     int preindex = (isClosed() && 0 == index) ? _count - 1 : index - 1;
@@ -211,6 +211,11 @@ bool MgShape::hasFillColor() const
     return context().hasFillColor() && shapec()->isClosed();
 }
 
+Box2d MgShape::getExtent() const
+{
+    return shapec()->getExtent();
+}
+
 bool MgShape::draw(int mode, GiGraphics& gs, const GiContext *ctx, int segment) const
 {
     GiContext tmpctx(context());
@@ -6,8 +6,15 @@
 #include "mgspfactory.h"
 #include "mglog.h"
 #include "mgcomposite.h"
+#include "githread.h"
 #include <list>
 #include <map>
+#include <set>
+
+static const int kMaxJournal = 1024;        // 变动日志超出此长度则丢弃前一半
+static volatile long _journalId = 0;
+
+struct MgNodeShape;
 
 struct MgShapes::I
 {
@@ -22,10 +29,32 @@ struct MgShapes::I
     int         index;
     int         newShapeID;
     volatile long refcount;
+    std::vector<int> journal;               // 增删改过的图形ID
+    long        journalId;
+    long        journalBase;                // journal[0] 的日志位置
     
     MgShape* findShape(int sid) const;
     int getNewID(int sid);
     
+    void logChange(int sid) {
+        if (journal.size() >= kMaxJournal) {
+            journal.erase(journal.begin(), journal.begin() + kMaxJournal / 2);
+            journalBase += kMaxJournal / 2;
+        }
+        journal.push_back(sid);
+    }
+    void notifyOwner(const MgShapes* self, const MgShape* sp, bool grown) {
+        if (owner && owner->isKindOf(MgComposite::Type())
+            && ((MgComposite*)owner)->shapes() == self) {
+            ((MgComposite*)owner)->childChanged(sp, grown);   // 更新复合图形的包络框
+        }
+    }
+    void resetJournal() {
+        journal.clear();
+        journalId = giAtomicIncrement(&_journalId);
+        journalBase = 0;
+    }
+    
     iterator findPosition(int sid) {
         iterator it = shapes.begin();
         for (; it != shapes.end() && (*it)->getID() != sid; ++it) ;
@@ -48,6 +77,7 @@ MgShapes::MgShapes(MgObject* owner, int index)
     im->index = index;
     im->newShapeID = 1;
     im->refcount = 1;
+    im->resetJournal();
 }
 
 MgShapes::~MgShapes()
@@ -101,9 +131,15 @@ int MgShapes::copyShapes(const MgShapes* src, bool deeply, bool needClear)
             sp->addRef();
             im->shapes.push_back(sp);
             im->id2shape[sp->getID()] = sp;
+            im->notifyOwner(this, sp, true);
             ret++;
         }
     }
+    if (!deeply && needClear) {             // 浅拷贝延续原日志
+        im->journal = src->im->journal;
+        im->journalId = src->im->journalId;
+        im->journalBase = src->im->journalBase;
+    }
     
     return ret;
 }
@@ -127,6 +163,7 @@ void MgShapes::clear()
     }
     im->shapes.clear();
     im->id2shape.clear();
+    im->resetJournal();
 }
 
 void MgShapes::clearCachedData()
@@ -151,11 +188,15 @@ bool MgShapes::updateShape(MgShape* shape, bool force)
     if (shape && (force || !shape->getParent() || shape->getParent() == this)) {
         I::iterator it = im->findPosition(shape->getID());
         if (it != im->shapes.end()) {
+            bool grown = shape->getExtent().contains((*it)->getExtent());
+            
             shape->shape()->resetChangeCount((*it)->shapec()->getChangeCount() + 1);
             (*it)->release();
             *it = shape;
             shape->setParent(this, shape->getID());
             im->id2shape[shape->getID()] = shape;
+            im->logChange(shape->getID());
+            im->notifyOwner(this, shape, grown);
             return true;
         }
     }
@@ -185,6 +226,8 @@ MgShape* MgShapes::addShape(const MgShape& src)
         p->setParent(this, im->getNewID(src.getID()));
         im->shapes.push_back(p);
         im->id2shape[p->getID()] = p;
+        im->logChange(p->getID());
+        im->notifyOwner(this, p, true);
     }
     return p;
 }
@@ -195,6 +238,8 @@ bool MgShapes::addShapeDirect(MgShape* shape, bool force)
         shape->setParent(this, im->getNewID(0));
         im->shapes.push_back(shape);
         im->id2shape[shape->getID()] = shape;
+        im->logChange(shape->getID());
+        im->notifyOwner(this, shape, true);
         return true;
     }
     return false;
@@ -207,6 +252,8 @@ MgShape* MgShapes::addShapeByType(MgShapeFactory* factory, int type)
         p->setParent(this, im->getNewID(0));
         im->shapes.push_back(p);
         im->id2shape[p->getID()] = p;
+        im->logChange(p->getID());
+        im->notifyOwner(this, p, true);
     }
     return p;
 }
@@ -219,13 +266,50 @@ bool MgShapes::removeShape(int sid)
         MgShape* shape = *it;
         im->shapes.erase(it);
         im->id2shape.erase(shape->getID());
+        im->logChange(sid);
         shape->release();
+        im->notifyOwner(this, NULL, false);
         return true;
     }
     
     return false;
 }
 
+int MgShapes::removeShapes(const int* ids, int count)
+{
+    std::set<int> sids;
+    
+    for (int i = 0; i < count; i++) {
+        if (im->findShape(ids[i]))
+            sids.insert(ids[i]);
+    }
+    if (sids.size() < 2) {
+        return (!sids.empty() && removeShape(*sids.begin())) ? 1 : 0;
+    }
+    
+    int n = 0;
+    
+    for (I::iterator it = im->shapes.begin();
+         it != im->shapes.end() && n < (int)sids.size(); ) {
+        MgShape* shape = *it;
+        if (sids.find(shape->getID()) != sids.end()) {
+            it = im->shapes.erase(it);
+            im->id2shape.erase(shape->getID());
+            im->logChange(shape->getID());
+            shape->release();
+            n++;
+        }
+        else {
+            ++it;
+        }
+    }
+    if (n > 0) {
+        im->notifyOwner(this, NULL, false);
+    }
+    
+    return n;
+}
+
 bool MgShapes::moveShapeTo(int sid, MgShapes* dest)
 {
     I::iterator it = im->findPosition(sid);
@@ -235,6 +319,8 @@ bool MgShapes::moveShapeTo(int sid, MgShapes* dest)
         newsp->setParent(dest, dest->im->getNewID(newsp->getID()));
         dest->im->shapes.push_back(newsp);
         dest->im->id2shape[newsp->getID()] = newsp;
+        dest->im->logChange(newsp->getID());
+        dest->im->notifyOwner(dest, newsp, true);
         
         return removeShape(sid);
     }
@@ -250,8 +336,38 @@ void MgShapes::copyShapesTo(MgShapes* dest) const
             newsp->setParent(dest, dest->im->getNewID(newsp->getID()));
             dest->im->shapes.push_back(newsp);
             dest->im->id2shape[newsp->getID()] = newsp;
+            dest->im->logChange(newsp->getID());
+            dest->im->notifyOwner(dest, newsp, true);
+        }
+    }
+}
+
+int MgShapes::moveShapesTo(MgShapes* dest)
+{
+    int count = 0;
+    
+    if (dest && dest != this) {
+        for (I::iterator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
+            MgShape* sp = *it;
+            const MgShape* oldsp = dest->findShape(sp->getID());
+            
+            if (oldsp && oldsp->shapec()->getType() == sp->shapec()->getType()) {
+                dest->updateShape(sp, true);    // 引用转给目标列表
+            } else {
+                sp->setParent(dest, dest->im->getNewID(sp->getID()));
+                dest->im->shapes.push_back(sp);
+                dest->im->id2shape[sp->getID()] = sp;
+                dest->im->logChange(sp->getID());
+                dest->im->notifyOwner(dest, sp, true);
+            }
+            count++;
         }
+        im->shapes.clear();
+        im->id2shape.clear();
+        im->resetJournal();
     }
+    
+    return count;
 }
 
 bool MgShapes::bringToFront(int sid)
@@ -262,6 +378,7 @@ bool MgShapes::bringToFront(int sid)
         MgShape* shape = *it;
         im->shapes.erase(it);
         im->shapes.push_back(shape);
+        im->notifyOwner(this, shape, false);   // 显示次序改变后需重建索引
         return true;
     }
     
@@ -372,7 +489,7 @@ Box2d MgShapes::getExtent() const
 {
     Box2d extent;
     for (I::citerator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
-        extent.unionWith((*it)->shapec()->getExtent());
+        extent.unionWith((*it)->getExtent());
     }
     
     return extent;
@@ -384,6 +501,9 @@ const MgShape* MgShapes::hitTest(const Box2d& limits, MgHitResult& res, Filter f
     
     res.dist = _FLT_MAX;
     for (I::citerator it = im->shapes.begin(); it != im->shapes.end(); ++it) {
+        if (!(*it)->getExtent().isIntersect(limits)) {
+            continue;                           // 范围不相交的图形不必取几何数据
+        }
         const MgBaseShape* shape = (*it)->shapec();
         Box2d extent(shape->getExtent());
         
@@ -418,7 +538,7 @@ int MgShapes::dyndraw(int mode, GiGraphics& gs, const GiContext *ctx, int segmen
     
     for (I::citerator it = im->shapes.begin(); it != im->shapes.end() && !gs.isStopping(); ++it) {
         const MgShape* sp = *it;
-        if (sp->shapec()->getExtent().isIntersect(clip)) {
+        if (sp->getExtent().isIntersect(clip)) {
             if (sp->draw(mode, gs, ctx, segment))
                 count++;
         }
@@ -460,7 +580,7 @@ bool MgShapes::saveShape(MgStorage* s, const MgShape* shape, int index) const
         s->writeInt("type", shape->getType() & 0xFFFF);
         s->writeInt("id", shape->getID());
         
-        Box2d rect(shape->shapec()->getExtent());
+        Box2d rect(shape->getExtent());
         s->writeFloatArray("extent", &rect.xmin, 4);
         
         ret = shape->save(s);
@@ -470,6 +590,141 @@ bool MgShapes::saveShape(MgStorage* s, const MgShape* shape, int index) const
     return ret;
 }
 
+//! 延迟加载几何数据的图形，首次取几何图形或显示属性时才从存取对象读取
+class MgLazyShape : public MgShape
+{
+public:
+    MgLazyShape(MgShape* sp, MgShapeFactory* factory, MgStorageSource* src, int pos)
+        : _sp(sp), _factory(factory), _src(src), _pos(pos)
+        , _state(kPending), _refcount(1) {
+        _src->addRef();
+    }
+    
+    const GiContext& context() const { ensureLoaded(); return _sp->context(); }
+    void setContext(const GiContext& ctx, int mask) { ensureLoaded(); _sp->setContext(ctx, mask); }
+    MgBaseShape* shape() { ensureLoaded(); return _sp->shape(); }
+    const MgBaseShape* shapec() const { ensureLoaded(); return _sp->shapec(); }
+    Box2d getExtent() const { return _sp->getExtent(); }
+    bool load(MgShapeFactory* factory, MgStorage* s) { ensureLoaded(); return _sp->load(factory, s); }
+    int getID() const { return _sp->getID(); }
+    MgShapes* getParent() const { return _sp->getParent(); }
+    void setParent(MgShapes* p, int sid) {
+        _sp->setParent(p, sid);
+        _sp->shape()->setOwner(this);       // 列表中的是本对象，组合图形的子图形列表应以本对象为拥有者
+    }
+    int getTag() const { ensureLoaded(); return _sp->getTag(); }
+    void setTag(int tag) { ensureLoaded(); _sp->setTag(tag); }
+    
+    MgObject* clone() const { ensureLoaded(); return _sp->clone(); }
+    int getType() const { return _sp->getType(); }
+    bool isKindOf(int type) const { return _sp->isKindOf(type); }
+    void addRef() { giAtomicIncrement(&_refcount); }
+    void release() {
+        if (giAtomicDecrement(&_refcount) == 0)
+            delete this;
+    }
+    
+private:
+    enum { kPending, kLoading, kLoaded };
+    
+    virtual ~MgLazyShape() {
+        if (_src) _src->release();
+        _sp->release();
+    }
+    void ensureLoaded() const { if (_state != kLoaded) const_cast<MgLazyShape*>(this)->materialize(); }
+    void materialize();
+    
+    MgShape*            _sp;            // 实际图形，加载前只有范围
+    MgShapeFactory*     _factory;
+    MgStorageSource*    _src;
+    int                 _pos;           // 图形节点在存取对象中的位置
+    volatile long       _state;
+    volatile long       _refcount;
+};
+
+void MgLazyShape::materialize()
+{
+    if (!giAtomicCompareAndSwap(&_state, kLoading, kPending)) {
+        while (_state != kLoaded) {     // 其他线程正在加载
+            giSleep(0);
+        }
+        return;
+    }
+    
+    MgStorage* s = _src->openNode(_pos);
+    bool ret = s && _sp->load(_factory, s);
+    
+    if (s) {
+        _src->closeNode(s);
+    }
+    _sp->shape()->setOwner(this);           // 加载时可能重设为实际图形
+    if (ret) {
+        _sp->shape()->setFlag(kMgClosed, _sp->shape()->isClosed());
+    } else {
+        LOGE("Fail to load shape (id=%d, type=%d)", _sp->getID(), _sp->getType() & 0xFFFF);
+    }
+    _src->release();
+    _src = NULL;
+    giAtomicCompareAndSwap(&_state, kLoaded, kLoading);
+}
+
+//! 已加入列表、待并行加载几何数据的图形
+struct MgNodeShape {
+    MgShape*    sp;
+    int         pos;            //!< 图形节点在存取对象中的位置
+    bool        loaded;
+};
+
+struct MgNodeLoader {
+    MgShapeFactory*             factory;
+    MgStorageSource*            src;
+    std::vector<MgNodeShape>*   shapes;
+    volatile long               next;
+};
+
+static void loadNodeShapesProc(void* param)
+{
+    const long kBatch = 64;                 // 每次领取的图形数，减少争用
+    MgNodeLoader* p = (MgNodeLoader*)param;
+    const long n = (long)p->shapes->size();
+    
+    for (long i = (giAtomicIncrement(&p->next) - 1) * kBatch; i < n;
+         i = (giAtomicIncrement(&p->next) - 1) * kBatch) {
+        for (long j = i; j < i + kBatch && j < n; j++) {
+            MgNodeShape& item = (*p->shapes)[j];
+            MgStorage* s = p->src->openNode(item.pos);
+            
+            item.loaded = s && item.sp->load(p->factory, s);
+            if (s) {
+                p->src->closeNode(s);
+            }
+            if (item.loaded) {
+                item.sp->shape()->setFlag(kMgClosed, item.sp->shape()->isClosed());
+            }
+        }
+    }
+}
+
+// 由多个线程并行加载图形的几何数据，各图形互不相关
+static void loadNodeShapes(MgShapeFactory* factory, MgStorageSource* src,
+                           std::vector<MgNodeShape>& shapes)
+{
+    const int kMaxWorkers = 7;
+    const int kMinShapesPerWorker = 256;
+    MgNodeLoader loader = { factory, src, &shapes, 0 };
+    GiThread workers[kMaxWorkers];
+    int n = mgMin(giProcessorCount() - 1, kMaxWorkers);
+    
+    n = mgMin(n, (int)shapes.size() / kMinShapesPerWorker);
+    for (int i = 0; i < n; i++) {
+        workers[i].start(loadNodeShapesProc, &loader);
+    }
+    loadNodeShapesProc(&loader);
+    for (int i = 0; i < n; i++) {
+        workers[i].join();
+    }
+}
+
 int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
 {
     Box2d rect;
@@ -477,8 +732,23 @@ int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
     bool ret = s && s->readNode("shapes", im->index, false);
     
     if (ret) {
-        if (!addOnly)
-            clear();
+        // 读出的图形先放在 loaded 中，全部读完且内容无误才加入列表，否则丢弃并保留原有图形
+        I::Container oldShapes;
+        I::ID2SHAPE oldIDs;
+        std::vector<MgShape*> loaded;
+        
+        if (!addOnly) {                         // 移开原有图形，新图形的ID不与其冲突
+            oldShapes.swap(im->shapes);
+            oldIDs.swap(im->id2shape);
+        }
+        
+        // 存取对象支持时顶层图形先只读范围，再延迟加载或并行加载，组合图形内的图形随其加载
+        MgStorageSource* src = s->getSource();
+        std::vector<MgNodeShape> nodeShapes;
+        
+        if (im->owner && im->owner->isKindOf(MgComposite::Type())) {
+            src = NULL;
+        }
         
         ret = loadExtra(s);
         s->readFloatArray("extent", &rect.xmin, 4, false);
@@ -498,16 +768,23 @@ int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
             if (newsp) {
                 newsp->setParent(this, oldsp ? sid : im->getNewID(sid));
                 newsp->shape()->setExtent(rect);
-                ret = newsp->load(factory, s);
+                if (src && !oldsp && s->tellNode() >= 0 && src->isLazy()) {
+                    newsp = new MgLazyShape(newsp, factory, src, s->tellNode());
+                    newsp->setParent(this, newsp->getID());
+                } else if (src && !oldsp && s->tellNode() >= 0) {
+                    MgNodeShape item = { newsp, s->tellNode(), false };
+                    nodeShapes.push_back(item);
+                } else {
+                    ret = newsp->load(factory, s);
+                    if (ret) {
+                        newsp->shape()->setFlag(kMgClosed, newsp->shape()->isClosed());
+                    }
+                }
                 if (ret) {
                     count++;
-                    newsp->shape()->setFlag(kMgClosed, newsp->shape()->isClosed());
-                    im->id2shape[newsp->getID()] = newsp;
-                    if (oldsp) {
-                        updateShape(newsp);
-                    }
-                    else {
-                        im->shapes.push_back(newsp);
+                    loaded.push_back(newsp);
+                    if (!oldsp) {
+                        im->id2shape[newsp->getID()] = newsp;   // 占用ID，替换的图形在提交时更新
                     }
                 }
                 else {
@@ -517,7 +794,57 @@ int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
             }
             s->readNode("shape", index++, true);
         }
+        if (!nodeShapes.empty() && !s->isBroken()) {
+            loadNodeShapes(factory, src, nodeShapes);
+        }
         s->readNode("shapes", im->index, true);
+        
+        const bool broken = s->isBroken();
+        std::vector<MgNodeShape>::const_iterator node = nodeShapes.begin();
+        
+        if (broken) {
+            LOGE("Discard %d shapes loaded from broken content", (int)loaded.size());
+            ret = false;
+            count = 0;
+        }
+        else if (!addOnly) {                    // 内容无误，释放原有图形
+            for (I::iterator it = oldShapes.begin(); it != oldShapes.end(); ++it) {
+                (*it)->release();
+            }
+            oldShapes.clear();
+            oldIDs.clear();
+            im->resetJournal();
+        }
+        for (size_t i = 0; i < loaded.size(); i++) {
+            MgShape* newsp = loaded[i];
+            bool failed = broken;
+            
+            if (node != nodeShapes.end() && node->sp == newsp) {    // 与 loaded 的次序相同
+                if (!(node++)->loaded && !broken) {
+                    LOGE("Fail to load shape (id=%d, type=%d)", newsp->getID(), newsp->getType() & 0xFFFF);
+                    failed = true;
+                    count--;
+                }
+            }
+            if (failed) {
+                if (im->findShape(newsp->getID()) == newsp) {
+                    im->id2shape.erase(newsp->getID());
+                }
+                newsp->release();
+            }
+            else if (im->findShape(newsp->getID()) != newsp) {  // 替换同ID的原图形
+                updateShape(newsp);
+            }
+            else {
+                im->shapes.push_back(newsp);
+                im->logChange(newsp->getID());
+                im->notifyOwner(this, newsp, true);
+            }
+        }
+        if (broken && !addOnly) {               // 恢复原有图形
+            im->shapes.swap(oldShapes);
+            im->id2shape.swap(oldIDs);
+        }
     }
     else if (s && im->index == 0) {
         s->setError("No shapes node.");
@@ -526,6 +853,23 @@ int MgShapes::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
     return ret ? count : (count > 0 ? -count : -1);
 }
 
+long MgShapes::getJournalPos(long& journalId) const
+{
+    journalId = im->journalId;
+    return im->journalBase + (long)im->journal.size();
+}
+
+bool MgShapes::getChangedIDs(long journalId, long pos, std::vector<int>& ids) const
+{
+    long end = im->journalBase + (long)im->journal.size();
+    
+    if (journalId != im->journalId || pos < im->journalBase || pos > end) {
+        return false;
+    }
+    ids.insert(ids.end(), im->journal.begin() + (pos - im->journalBase), im->journal.end());
+    return true;
+}
+
 void MgShapes::setNewShapeID(int sid)
 {
     im->newShapeID = sid;
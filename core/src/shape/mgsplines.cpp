@@ -149,6 +149,13 @@ bool MgSplines::removePoint(int index)
     return __super::removePoint(index);
 }
 
+int MgSplines::simplify(float tol)
+{
+    if (_knotvs)            // 已拟合为贝塞尔曲线的顶点不能单独去掉
+        return 0;
+    return __super::simplify(tol);
+}
+
 bool MgSplines::smooth(const Matrix2d& m2d, float tol)
 {
     return smoothForPoints(_count, _points, m2d, tol) > 0;
@@ -185,3 +192,25 @@ int MgSplines::smoothForPoints(int count, const Point2d* points, const Matrix2d&
     
     return _count;
 }
+
+bool MgSplines::setFittedKnots(int count, const Point2d* knots, const Vector2d* knotvs, const Matrix2d& d2m)
+{
+    if (count < 2 || !knots || !knotvs)
+        return false;
+    
+    Point2d* pts = new Point2d[count];
+    Vector2d* vecs = new Vector2d[count];
+    
+    for (int i = 0; i < count; i++) {
+        pts[i] = knots[i] * d2m;
+        vecs[i] = knotvs[i] * d2m;
+    }
+    delete[] _points;
+    _points = pts;
+    _maxCount = _count = count;
+    delete[] _knotvs;
+    _knotvs = vecs;
+    update();
+    
+    return true;
+}
@@ -348,7 +348,7 @@ bool MgShapeDoc::load(MgShapeFactory* factory, MgStorage* s, bool addOnly)
 
     s->readNode("shapedoc", -1, true);
 
-    return ret;
+    return ret && !s->isBroken();               // 后面的图层内容有错时也算失败
 }
 
 bool MgShapeDoc::saveAll(MgStorage* s, const GiTransform* xform)
@@ -0,0 +1,901 @@
+﻿// mgbinstorage.cpp
+// Copyright (c) 2004-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#include "mgbinstorage.h"
+#include "mgstorage.h"
+#include "mgmappedfile.h"
+#include "gilock.h"
+#include "mglog.h"
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <deque>
+#include <map>
+
+//! 二进制内容的标记类型，每个标记后跟键号(kBinKey、kBinNodeEnd除外)和值
+enum {
+    kBinKey = 1,        //!< 定义新键名: 长度, 字符，键号按出现次序从0开始
+    kBinNodeBegin,      //!< 节点开始: 键号, 节点序号+1
+    kBinNodeEnd,        //!< 节点结束
+    kBinInt,            //!< 有符号整数: 键号, zigzag变长数
+    kBinUInt,           //!< 无符号整数: 键号, 变长数
+    kBinTrue,           //!< 布尔值true: 键号
+    kBinFalse,          //!< 布尔值false: 键号
+    kBinFloat,          //!< 浮点数: 键号, 4字节小端
+    kBinFloats,         //!< 浮点数数组: 键号, 个数, 4*个数字节小端
+    kBinString,         //!< 字符串: 键号, 长度, 字符(无结束符)
+    kBinQuantFloats,    //!< 量化的坐标数组: 键号, 个数, 精度(4字节), 与同轴前一数的整数差(zigzag变长数)
+};
+
+static const unsigned char kBinMagic[] = { 'V', 'G', 'B', 2 };  // 文件标识和版本
+static const int kQuantMinCount = 7;    // 超过6个数的数组才量化，变换矩阵和矩形范围保持原值
+
+static inline bool isLittleEndian()
+{
+    const int one = 1;
+    return *(const char*)&one == 1;
+}
+
+static void copyFloats(void* dest, const void* src, int count)
+{
+    if (isLittleEndian()) {
+        memcpy(dest, src, count * 4);
+    } else {
+        const unsigned char* s = (const unsigned char*)src;
+        unsigned char* d = (unsigned char*)dest;
+        for (int i = 0; i < count; i++, s += 4, d += 4) {
+            d[0] = s[3]; d[1] = s[2]; d[2] = s[1]; d[3] = s[0];
+        }
+    }
+}
+
+struct StrLess {
+    bool operator()(const char* a, const char* b) const { return strcmp(a, b) < 0; }
+};
+
+//! 二进制序列化适配器类，内部实现类
+class MgBinStorage::Impl : public MgStorage, public MgStorageSource
+{
+public:
+    Impl() : _data(NULL), _size(0), _err(NULL), _unit(0), _keep(false), _lazy(false), _refcount(1) {}
+    virtual ~Impl() {}
+    
+    void clear();
+    void beginWrite();
+    void setPrecision(float unit) { _unit = unit > 0 ? unit : 0; }
+    float getPrecision() const { return _unit; }
+    void keepForSource(bool lazy) { _keep = true; _lazy = lazy; }
+    bool isShared() const { return _refcount > 1; }
+    void addRef() { giAtomicIncrement(&_refcount); }
+    void release() { if (giAtomicDecrement(&_refcount) == 0) delete this; }
+    bool parse(const unsigned char* data, int size);
+    MgMappedFile& file() { return _file; }
+    bool copyTo(MgStorage* dest);
+    std::vector<unsigned char>& buffer() { return _buf; }
+    const char* getError() const { return _err; }
+    
+private:
+    bool readNode(const char* name, int index, bool ended);
+    bool writeNode(const char* name, int index, bool ended);
+    bool setError(const char* err);
+    
+    int readInt(const char* name, int defvalue);
+    bool readBool(const char* name, bool defvalue);
+    float readFloat(const char* name, float defvalue);
+    int readFloatArray(const char* name, float* values, int count, bool report = true);
+    int readString(const char* name, char* value, int count);
+    
+    void writeInt(const char* name, int value);
+    void writeUInt(const char* name, int value);
+    void writeBool(const char* name, bool value);
+    void writeFloat(const char* name, float value);
+    void writeFloatArray(const char* name, const float* values, int count);
+    void writeString(const char* name, const char* value);
+    
+    MgStorageSource* getSource() { return _keep && !_items.empty() ? this : NULL; }
+    int tellNode() { return _stack.size() > 1 ? _stack.back().node : -1; }
+    bool isLazy() { return _lazy; }
+    MgStorage* openNode(int pos);
+    void closeNode(MgStorage* s);
+    
+private:
+    class Reader;
+    friend class Reader;
+    
+    struct Item {           //!< 解析出的键值项或节点
+        int key;            //!< 键号
+        int index;          //!< 节点序号，-1表示唯一节点
+        int tag;            //!< 标记类型
+        int count;          //!< 数组个数或字符串长度
+        int offset;         //!< 值在内容中的位置
+        int end;            //!< 节点的下一个同级项的序号
+    };
+    struct Level {          //!< 正在读取的节点
+        int node;           //!< 节点项的序号，-1表示根
+        int cursor;         //!< 下次从此项开始查找，顺序读取时可直接命中
+    };
+    typedef std::map<const char*, int, StrLess> KeyMap;
+    typedef std::vector<Level> Levels;
+    
+    void clearItems();
+    void writeKey(int tag, const char* name);
+    void writeVarint(unsigned value);
+    bool writeQuantized(const float* values, int count);
+    bool readVarint(int& pos, unsigned& value) const;
+    int readFloats(const Item& item, float* values, int count) const;
+    
+    // 以下读取函数只改变传入的节点栈，内容解析后可在多个线程中同时调用
+    const Item* findItem(Levels& stack, const char* name, int index, bool node) const;
+    bool enterNode(Levels& stack, const char* name, int index) const;
+    int getInt(Levels& stack, const char* name, int defvalue) const;
+    bool getBool(Levels& stack, const char* name, bool defvalue) const;
+    float getFloat(Levels& stack, const char* name, float defvalue) const;
+    int getFloatArray(Levels& stack, const char* name, float* values, int count, bool report) const;
+    int getString(Levels& stack, const char* name, char* value, int count) const;
+    
+private:
+    std::vector<unsigned char>  _buf;       // 写入的内容或读入的文件内容
+    MgMappedFile                _file;      // 映射读取的文件，读完根节点后关闭
+    const unsigned char*        _data;      // 正在读取的内容
+    int                         _size;
+    std::vector<Item>           _items;
+    Levels                      _stack;
+    std::deque<std::string>     _keys;      // 键名表，元素地址不变
+    KeyMap                      _keymap;
+    const char*                 _err;
+    float                       _unit;      // 坐标量化精度
+    bool                        _keep;      // 读完根节点后是否保留内容，供 MgStorageSource 使用
+    bool                        _lazy;
+    volatile long               _refcount;
+};
+
+//! 在已解析的共享内容上独立读取一个节点，多个对象可在不同线程中同时读取
+class MgBinStorage::Impl::Reader : public MgStorage
+{
+public:
+    Reader(const Impl* owner, int pos) : _owner(owner) {
+        Level root = { -1, 0 };
+        Level level = { pos, pos + 1 };
+        _stack.push_back(root);
+        _stack.push_back(level);
+    }
+    virtual ~Reader() {}
+    
+    bool readNode(const char* name, int index, bool ended) {
+        if (!ended) {
+            return _owner->enterNode(_stack, name, index);
+        }
+        if (_stack.size() > 2) {
+            _stack.pop_back();
+        }
+        return true;
+    }
+    int readInt(const char* name, int defvalue) {
+        return _owner->getInt(_stack, name, defvalue);
+    }
+    bool readBool(const char* name, bool defvalue) {
+        return _owner->getBool(_stack, name, defvalue);
+    }
+    float readFloat(const char* name, float defvalue) {
+        return _owner->getFloat(_stack, name, defvalue);
+    }
+    int readFloatArray(const char* name, float* values, int count, bool report = true) {
+        return _owner->getFloatArray(_stack, name, values, count, report);
+    }
+    int readString(const char* name, char* value, int count) {
+        return _owner->getString(_stack, name, value, count);
+    }
+    
+    bool writeNode(const char*, int, bool) { return false; }
+    void writeBool(const char*, bool) {}
+    void writeFloat(const char*, float) {}
+    void writeString(const char*, const char*) {}
+    void writeFloatArray(const char*, const float*, int) {}
+    
+private:
+    const Impl* _owner;
+    Levels      _stack;
+};
+
+MgBinStorage::MgBinStorage() : _impl(new Impl())
+{
+}
+
+MgBinStorage::~MgBinStorage()
+{
+    _impl->release();
+}
+
+MgBinStorage::Impl* MgBinStorage::detach()
+{
+    if (_impl->isShared()) {                    // 内容仍被延迟加载的图形引用，改用新对象
+        Impl* p = new Impl();
+        p->setPrecision(_impl->getPrecision());
+        _impl->release();
+        _impl = p;
+    }
+    return _impl;
+}
+
+MgStorage* MgBinStorage::storageForRead(const void* data, int size)
+{
+    detach()->clear();
+    if (data && size > 0 && !_impl->parse((const unsigned char*)data, size)) {
+        LOGE("parse error: %s", _impl->getError());
+    }
+    return _impl;
+}
+
+MgStorage* MgBinStorage::storageForMapping(const char* filename, bool lazy)
+{
+    MgMappedFile& file = detach()->file();
+    
+    _impl->clear();
+    if (!filename || !file.open(filename)) {
+        return NULL;
+    }
+    _impl->keepForSource(lazy);
+    if (file.size() > 0 && !_impl->parse(file.data(), file.size())) {
+        LOGE("parse error: %s", _impl->getError());
+    }
+    return _impl;
+}
+
+MgStorage* MgBinStorage::storageForRead(FILE* fp)
+{
+    detach()->clear();
+    if (fp) {
+        std::vector<unsigned char>& buf = _impl->buffer();
+        unsigned char tmp[4096];
+        size_t n;
+        
+        while ((n = fread(tmp, 1, sizeof(tmp), fp)) > 0) {
+            buf.insert(buf.end(), tmp, tmp + n);
+        }
+        if (!buf.empty() && !_impl->parse(&buf.front(), (int)buf.size())) {
+            LOGE("parse error: %s", _impl->getError());
+        }
+    }
+    return _impl;
+}
+
+MgStorage* MgBinStorage::storageForWrite()
+{
+    detach()->clear();
+    _impl->beginWrite();
+    return _impl;
+}
+
+void MgBinStorage::setPrecision(float unit)
+{
+    _impl->setPrecision(unit);
+}
+
+bool MgBinStorage::copyTo(MgStorage* dest)
+{
+    return dest && _impl->copyTo(dest);
+}
+
+bool MgBinStorage::save(FILE* fp)
+{
+    const std::vector<unsigned char>& buf = _impl->buffer();
+    return fp && !buf.empty() && fwrite(&buf.front(), 1, buf.size(), fp) == buf.size();
+}
+
+const unsigned char* MgBinStorage::getData() const
+{
+    return _impl->buffer().empty() ? NULL : &_impl->buffer().front();
+}
+
+int MgBinStorage::getSize() const
+{
+    return (int)_impl->buffer().size();
+}
+
+void MgBinStorage::swapData(std::vector<unsigned char>& data)
+{
+    _impl->buffer().swap(data);
+}
+
+void MgBinStorage::clear()
+{
+    detach()->clear();
+}
+
+const char* MgBinStorage::getParseError()
+{
+    return _impl->getError();
+}
+
+bool MgBinStorage::isBinary(const void* data, int size)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    return p && size >= (int)sizeof(kBinMagic)
+        && memcmp(p, kBinMagic, 3) == 0 && p[3] > 0 && p[3] <= kBinMagic[3];
+}
+
+bool MgBinStorage::isBinaryFile(FILE* fp)
+{
+    unsigned char head[sizeof(kBinMagic)];
+    long pos = fp ? ftell(fp) : -1;
+    bool ret = false;
+    
+    if (pos >= 0) {
+        ret = fread(head, 1, sizeof(head), fp) == sizeof(head) && isBinary(head, sizeof(head));
+        fseek(fp, pos, SEEK_SET);
+    }
+    return ret;
+}
+
+// MgBinStorage::Impl
+//
+
+void MgBinStorage::Impl::clearItems()
+{
+    _data = NULL;
+    _size = 0;
+    _items.clear();
+    _stack.clear();
+    _keys.clear();
+    _keymap.clear();
+}
+
+void MgBinStorage::Impl::clear()
+{
+    clearItems();
+    _buf.clear();
+    _file.close();
+    _keep = false;
+    _lazy = false;
+}
+
+bool MgBinStorage::Impl::setError(const char* err)
+{
+    _err = err;
+    if (err) {
+        LOGE("storage error: %s", err);
+    }
+    return false;
+}
+
+void MgBinStorage::Impl::beginWrite()
+{
+    _buf.assign(kBinMagic, kBinMagic + sizeof(kBinMagic));
+    _err = NULL;
+}
+
+void MgBinStorage::Impl::writeVarint(unsigned value)
+{
+    while (value >= 0x80) {
+        _buf.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    _buf.push_back((unsigned char)value);
+}
+
+void MgBinStorage::Impl::writeKey(int tag, const char* name)
+{
+    KeyMap::const_iterator it = _keymap.find(name);
+    int key;
+    
+    if (it != _keymap.end()) {
+        key = it->second;
+    } else {                                    // 首次出现的键名先写入键名表
+        key = (int)_keys.size();
+        _keys.push_back(name);
+        _keymap[_keys.back().c_str()] = key;
+        
+        _buf.push_back(kBinKey);
+        writeVarint((unsigned)_keys.back().size());
+        _buf.insert(_buf.end(), _keys.back().begin(), _keys.back().end());
+    }
+    _buf.push_back((unsigned char)tag);
+    writeVarint((unsigned)key);
+}
+
+bool MgBinStorage::Impl::writeNode(const char* name, int index, bool ended)
+{
+    if (!ended) {
+        if (_buf.empty()) {
+            beginWrite();
+        }
+        writeKey(kBinNodeBegin, name);
+        writeVarint((unsigned)(index < 0 ? 0 : index + 1));
+    } else {
+        _buf.push_back(kBinNodeEnd);
+    }
+    return true;
+}
+
+void MgBinStorage::Impl::writeInt(const char* name, int value)
+{
+    writeKey(kBinInt, name);
+    writeVarint(((unsigned)value << 1) ^ (unsigned)(value >> 31));  // zigzag
+}
+
+void MgBinStorage::Impl::writeUInt(const char* name, int value)
+{
+    writeKey(kBinUInt, name);
+    writeVarint((unsigned)value);
+}
+
+void MgBinStorage::Impl::writeBool(const char* name, bool value)
+{
+    writeKey(value ? kBinTrue : kBinFalse, name);
+}
+
+void MgBinStorage::Impl::writeFloat(const char* name, float value)
+{
+    unsigned char tmp[4];
+    
+    writeKey(kBinFloat, name);
+    copyFloats(tmp, &value, 1);
+    _buf.insert(_buf.end(), tmp, tmp + 4);
+}
+
+void MgBinStorage::Impl::writeFloatArray(const char* name, const float* values, int count)
+{
+    count = values && count > 0 ? count : 0;
+    if (_unit > 0 && count >= kQuantMinCount) {
+        size_t pos = _buf.size();
+        
+        writeKey(kBinQuantFloats, name);
+        if (writeQuantized(values, count)) {
+            return;
+        }
+        _buf.resize(pos);                       // 超出范围，改为原样保存
+    }
+    writeKey(kBinFloats, name);
+    writeVarint((unsigned)count);
+    
+    size_t pos = _buf.size();
+    _buf.resize(pos + count * 4);
+    if (count > 0) {
+        copyFloats(&_buf[pos], values, count);
+    }
+}
+
+bool MgBinStorage::Impl::writeQuantized(const float* values, int count)
+{
+    const float maxq = 1e9f;
+    unsigned char tmp[4];
+    int last[2] = { 0, 0 };
+    
+    writeVarint((unsigned)count);
+    copyFloats(tmp, &_unit, 1);
+    _buf.insert(_buf.end(), tmp, tmp + 4);
+    
+    for (int i = 0; i < count; i++) {
+        float q = values[i] / _unit;
+        
+        if (!(q > -maxq && q < maxq)) {         // 也排除了NaN
+            return false;
+        }
+        int v = (int)(q < 0 ? q - 0.5f : q + 0.5f);
+        int d = v - last[i % 2];
+        
+        last[i % 2] = v;
+        writeVarint(((unsigned)d << 1) ^ (unsigned)(d >> 31));
+    }
+    return true;
+}
+
+void MgBinStorage::Impl::writeString(const char* name, const char* value)
+{
+    int len = value ? (int)strlen(value) : 0;
+    
+    writeKey(kBinString, name);
+    writeVarint((unsigned)len);
+    _buf.insert(_buf.end(), value, value + len);
+}
+
+bool MgBinStorage::Impl::readVarint(int& pos, unsigned& value) const
+{
+    value = 0;
+    for (int shift = 0; pos < _size && shift < 35; shift += 7) {
+        unsigned char b = _data[pos++];
+        value |= (unsigned)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+bool MgBinStorage::Impl::parse(const unsigned char* data, int size)
+{
+    std::vector<int> opens;                     // 未结束的节点项
+    unsigned key = 0, value;
+    
+    clearItems();
+    _err = NULL;
+    if (!MgBinStorage::isBinary(data, size)) {
+        return setError("Not a binary storage.");
+    }
+    _data = data;
+    _size = size;
+    
+    for (int pos = sizeof(kBinMagic); pos < size; ) {
+        const int tag = data[pos++];
+        Item item = { 0, -1, tag, 0, 0, 0 };
+        
+        if (tag != kBinKey && tag != kBinNodeEnd) {
+            if (!readVarint(pos, key) || key >= _keys.size()) {
+                return setError("Invalid key in binary storage.");
+            }
+            item.key = (int)key;
+        }
+        switch (tag) {
+            case kBinKey:
+                if (!readVarint(pos, value) || value > (unsigned)(size - pos)) {
+                    return setError("Invalid key name in binary storage.");
+                }
+                _keys.push_back(std::string((const char*)data + pos, value));
+                _keymap[_keys.back().c_str()] = (int)_keys.size() - 1;
+                pos += (int)value;
+                continue;
+                
+            case kBinNodeBegin:
+                if (!readVarint(pos, value)) {
+                    return setError("Invalid node in binary storage.");
+                }
+                item.index = (int)value - 1;
+                opens.push_back((int)_items.size());
+                break;
+                
+            case kBinNodeEnd:
+                if (opens.empty()) {
+                    return setError("Unmatched node in binary storage.");
+                }
+                _items[opens.back()].end = (int)_items.size();
+                opens.pop_back();
+                continue;
+                
+            case kBinInt:
+            case kBinUInt:
+                item.offset = pos;
+                if (!readVarint(pos, value)) {
+                    return setError("Invalid integer in binary storage.");
+                }
+                break;
+                
+            case kBinTrue:
+            case kBinFalse:
+                break;
+                
+            case kBinFloat:
+                item.offset = pos;
+                pos += 4;
+                break;
+                
+            case kBinQuantFloats:
+                if (!readVarint(pos, value) || value > (unsigned)(size - pos)) {
+                    return setError("Invalid array in binary storage.");
+                }
+                item.count = (int)value;
+                item.offset = pos;
+                pos += 4;
+                for (unsigned i = 0; i < value; i++) {
+                    unsigned d;
+                    if (!readVarint(pos, d)) {
+                        return setError("Truncated binary storage.");
+                    }
+                }
+                break;
+                
+            case kBinFloats:
+            case kBinString:
+                if (!readVarint(pos, value) || value > (unsigned)(size - pos)) {
+                    return setError("Invalid array in binary storage.");
+                }
+                item.count = (int)value;
+                item.offset = pos;
+                pos += (int)value * (tag == kBinFloats ? 4 : 1);
+                break;
+                
+            default:
+                return setError("Unknown tag in binary storage.");
+        }
+        if (pos > size) {
+            return setError("Truncated binary storage.");
+        }
+        _items.push_back(item);
+    }
+    if (!opens.empty()) {
+        return setError("Truncated binary storage.");
+    }
+    
+    Level root = { -1, 0 };
+    _stack.push_back(root);
+    
+    return true;
+}
+
+const MgBinStorage::Impl::Item* MgBinStorage::Impl::findItem(Levels& stack, const char* name,
+                                                             int index, bool node) const
+{
+    KeyMap::const_iterator k = stack.empty() ? _keymap.end() : _keymap.find(name);
+    if (k == _keymap.end()) {
+        return NULL;
+    }
+    
+    Level& level = stack.back();
+    const int first = level.node < 0 ? 0 : level.node + 1;
+    const int last = level.node < 0 ? (int)_items.size() : _items[level.node].end;
+    
+    for (int pass = 0; pass < 2; pass++) {      // 先从上次位置向后找，再从头找
+        int i = pass ? first : level.cursor;
+        const int stop = pass ? level.cursor : last;
+        
+        while (i < stop) {
+            const Item& item = _items[i];
+            const bool isnode = (item.tag == kBinNodeBegin);
+            
+            if (item.key == k->second && isnode == node && (!node || item.index == index)) {
+                level.cursor = isnode ? item.end : i + 1;
+                return &item;
+            }
+            i = isnode ? item.end : i + 1;      // 跳过子节点的内容
+        }
+    }
+    
+    return NULL;
+}
+
+bool MgBinStorage::Impl::enterNode(Levels& stack, const char* name, int index) const
+{
+    const Item* item = findItem(stack, name, index < 0 ? -1 : index, true);
+    if (!item) {
+        return false;
+    }
+    Level level = { (int)(item - &_items.front()), (int)(item - &_items.front()) + 1 };
+    stack.push_back(level);
+    return true;
+}
+
+bool MgBinStorage::Impl::readNode(const char* name, int index, bool ended)
+{
+    if (!ended) {
+        if (!enterNode(_stack, name, index)) {
+            return false;
+        }
+        _err = NULL;
+    }
+    else {
+        if (_stack.size() > 1) {
+            _stack.pop_back();
+        }
+        if (_stack.size() < 2 && !_keep) {      // 根节点已读完
+            clear();
+        }
+    }
+    return true;
+}
+
+MgStorage* MgBinStorage::Impl::openNode(int pos)
+{
+    if (pos < 0 || pos >= (int)_items.size() || _items[pos].tag != kBinNodeBegin) {
+        return NULL;
+    }
+    return new Reader(this, pos);
+}
+
+void MgBinStorage::Impl::closeNode(MgStorage* s)
+{
+    delete (Reader*)s;
+}
+
+int MgBinStorage::Impl::readInt(const char* name, int defvalue)
+{
+    return getInt(_stack, name, defvalue);
+}
+
+bool MgBinStorage::Impl::readBool(const char* name, bool defvalue)
+{
+    return getBool(_stack, name, defvalue);
+}
+
+float MgBinStorage::Impl::readFloat(const char* name, float defvalue)
+{
+    return getFloat(_stack, name, defvalue);
+}
+
+int MgBinStorage::Impl::readFloatArray(const char* name, float* values, int count, bool report)
+{
+    int ret = getFloatArray(_stack, name, values, count, report);
+    
+    if (values && ret < count && report && count > 0) {
+        setError("readFloatArray: lose numbers.");
+    }
+    return ret;
+}
+
+int MgBinStorage::Impl::readString(const char* name, char* value, int count)
+{
+    return getString(_stack, name, value, count);
+}
+
+int MgBinStorage::Impl::getInt(Levels& stack, const char* name, int defvalue) const
+{
+    const Item* item = findItem(stack, name, -1, false);
+    unsigned value;
+    int pos;
+    
+    if (!item) {
+        return defvalue;
+    }
+    pos = item->offset;
+    switch (item->tag) {
+        case kBinInt:
+            readVarint(pos, value);
+            return (int)(value >> 1) ^ -(int)(value & 1);
+        case kBinUInt:
+            readVarint(pos, value);
+            return (int)value;
+        case kBinString:                        // 可能是从JSON转换来的十六进制串
+            if (item->count < 16) {
+                char str[16], *endptr;
+                memcpy(str, _data + pos, item->count);
+                str[item->count] = 0;
+                int ret = (int)strtoul(str, &endptr, 0);
+                if (*str && !*endptr)
+                    return ret;
+            }
+            LOGD("Invalid value for readInt(%s)", name);
+            return defvalue;
+        default:
+            LOGD("Invalid value for readInt(%s)", name);
+            return defvalue;
+    }
+}
+
+bool MgBinStorage::Impl::getBool(Levels& stack, const char* name, bool defvalue) const
+{
+    const Item* item = findItem(stack, name, -1, false);
+    
+    if (item && (item->tag == kBinTrue || item->tag == kBinFalse)) {
+        return item->tag == kBinTrue;
+    }
+    if (item) {
+        LOGD("Invalid value for readBool(%s)", name);
+    }
+    return defvalue;
+}
+
+float MgBinStorage::Impl::getFloat(Levels& stack, const char* name, float defvalue) const
+{
+    const Item* item = findItem(stack, name, -1, false);
+    float ret = defvalue;
+    
+    if (item && item->tag == kBinFloat) {
+        copyFloats(&ret, _data + item->offset, 1);
+    }
+    else if (item && (item->tag == kBinInt || item->tag == kBinUInt)) {
+        ret = (float)getInt(stack, name, 0);
+    }
+    else if (item) {
+        LOGD("Invalid value for readFloat(%s)", name);
+    }
+    return ret;
+}
+
+int MgBinStorage::Impl::getFloatArray(Levels& stack, const char* name,
+                                      float* values, int count, bool report) const
+{
+    const Item* item = findItem(stack, name, -1, false);
+    int ret = 0;
+    
+    report = report && count > 0 && values;
+    if (item && (item->tag == kBinFloats || item->tag == kBinQuantFloats)) {
+        ret = item->count;
+        if (values) {
+            ret = readFloats(*item, values, ret < count ? ret : count);
+        }
+    }
+    else if (item && report) {
+        LOGD("Invalid value for readFloatArray(%s)", name);
+    }
+    
+    return ret;
+}
+
+int MgBinStorage::Impl::getString(Levels& stack, const char* name, char* value, int count) const
+{
+    const Item* item = findItem(stack, name, -1, false);
+    int ret = 0;
+    
+    if (item && item->tag == kBinString) {
+        ret = item->count;
+        if (value) {
+            ret = ret < count ? ret : count;
+            memcpy(value, _data + item->offset, ret);
+        }
+    }
+    else if (item) {
+        LOGD("Invalid value for readString(%s)", name);
+    }
+    return ret;
+}
+
+int MgBinStorage::Impl::readFloats(const Item& item, float* values, int count) const
+{
+    if (item.tag == kBinFloats) {
+        copyFloats(values, _data + item.offset, count);
+        return count;
+    }
+    
+    int pos = item.offset + 4;
+    int last[2] = { 0, 0 };
+    unsigned d;
+    float unit;
+    
+    copyFloats(&unit, _data + item.offset, 1);
+    for (int i = 0; i < count && readVarint(pos, d); i++) {
+        last[i % 2] += (int)(d >> 1) ^ -(int)(d & 1);
+        values[i] = (float)last[i % 2] * unit;
+    }
+    return count;
+}
+
+bool MgBinStorage::Impl::copyTo(MgStorage* dest)
+{
+    std::vector<int> nodes;                     // 未结束的节点项
+    std::vector<float> floats;
+    std::string str;
+    unsigned value;
+    int pos, i;
+    
+    if (_items.empty()) {
+        return false;
+    }
+    for (i = 0; ; i++) {
+        while (!nodes.empty() && _items[nodes.back()].end == i) {
+            const Item& node = _items[nodes.back()];
+            dest->writeNode(_keys[node.key].c_str(), node.index, true);
+            nodes.pop_back();
+        }
+        if (i == (int)_items.size()) {
+            break;
+        }
+        
+        const Item& item = _items[i];
+        const char* name = _keys[item.key].c_str();
+        
+        switch (item.tag) {
+            case kBinNodeBegin:
+                dest->writeNode(name, item.index, false);
+                nodes.push_back(i);
+                break;
+            case kBinInt:
+                pos = item.offset;
+                readVarint(pos, value);
+                dest->writeInt(name, (int)(value >> 1) ^ -(int)(value & 1));
+                break;
+            case kBinUInt:
+                pos = item.offset;
+                readVarint(pos, value);
+                dest->writeUInt(name, (int)value);
+                break;
+            case kBinTrue:
+            case kBinFalse:
+                dest->writeBool(name, item.tag == kBinTrue);
+                break;
+            case kBinFloat:
+                floats.resize(1);
+                copyFloats(&floats.front(), _data + item.offset, 1);
+                dest->writeFloat(name, floats.front());
+                break;
+            case kBinFloats:
+            case kBinQuantFloats:
+                floats.resize(item.count + 1);
+                readFloats(item, &floats.front(), item.count);
+                dest->writeFloatArray(name, &floats.front(), item.count);
+                break;
+            case kBinString:
+                str.assign((const char*)_data + item.offset, item.count);
+                dest->writeString(name, str.c_str());
+                break;
+        }
+    }
+    return true;
+}
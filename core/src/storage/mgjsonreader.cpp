@@ -0,0 +1,655 @@
+﻿// mgjsonreader.cpp
+// Copyright (c) 2004-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#include "mgjsonreader.h"
+#include "mgstorage.h"
+#include "mglog.h"
+#include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+//! 已扫描到的简单成员的值
+struct MgJsonValue
+{
+    char                type;       //!< 'i' 整数, 'f' 浮点数, 's' 字符串, 'a' 数组, 't' 真, 'b' 假, 'n' 空
+    double              number;
+    std::string         str;
+    std::vector<float>  arr;
+};
+
+//! 正在读取的一级节点
+struct MgJsonFrame
+{
+    std::map<std::string, MgJsonValue> values;  //!< 已扫描到的简单成员
+    std::map<std::string, long> skipped;        //!< 已扫描过而未读取的子节点的位置
+    std::string         name;       //!< 本节点在上级节点中的名称
+    std::string         pending;    //!< 当前位置的子节点的名称，还未进入
+    long                resume;     //!< 节点读完后返回的位置，-1表示不用返回
+    bool                closed;     //!< 是否已扫描到节点结尾
+    
+    MgJsonFrame() : resume(-1), closed(false) {}
+};
+
+//! 流式JSON读取适配器类，内部实现类
+class MgJsonReader::Impl : public MgStorage
+{
+public:
+    Impl() : _fp(NULL), _data(NULL), _err(NULL), _broken(false) { reset(); }
+    virtual ~Impl() {}
+    
+    void clear();
+    void open(FILE* fp, const char* content);
+    const char* getError() const { return _err; }
+    
+private:
+    bool readNode(const char* name, int index, bool ended);
+    bool writeNode(const char*, int, bool) { return false; }
+    bool setError(const char* err);
+    bool isBroken() { return _broken; }
+    
+    int readInt(const char* name, int defvalue);
+    bool readBool(const char* name, bool defvalue);
+    float readFloat(const char* name, float defvalue);
+    int readFloatArray(const char* name, float* values, int count, bool report = true);
+    int readString(const char* name, char* value, int count);
+    
+    void writeBool(const char*, bool) {}
+    void writeFloat(const char*, float) {}
+    void writeFloatArray(const char*, const float*, int) {}
+    void writeString(const char*, const char*) {}
+    
+private:
+    void reset();
+    bool fill();
+    int peek() { return (_pos < _len || fill()) ? (unsigned char)_data[_pos] : -1; }
+    int get() { int c = peek(); if (c >= 0) _pos++; return c; }
+    long tell() const { return _base + _pos; }
+    void seek(long offset);
+    void skipSpace();
+    bool syntaxError(const char* err);
+    bool parseString(std::string& str);
+    bool parseNumber(MgJsonValue* value);
+    bool parseLiteral(const char* word);
+    bool parseValue(MgJsonValue* value);
+    bool advance(MgJsonFrame& frame, bool store);
+    bool enterNode(const char* name, long resume);
+    const MgJsonValue* findValue(const char* name);
+    
+private:
+    FILE*               _fp;
+    long                _start;     // 文件中的起始位置
+    const char*         _data;      // 当前缓冲区，内存方式时为全部内容
+    long                _base;      // 缓冲区开头的位置
+    int                 _len;
+    int                 _pos;
+    char                _buf[4096];
+    std::deque<MgJsonFrame> _stack; // 最底层为根对象
+    const char*         _err;
+    bool                _broken;    // 遇到语法错误，后面的内容不再读取
+};
+
+MgJsonReader::MgJsonReader() : _impl(new Impl())
+{
+}
+
+MgJsonReader::~MgJsonReader()
+{
+    delete _impl;
+}
+
+MgStorage* MgJsonReader::storageForRead(const char* content)
+{
+    _impl->open(NULL, content ? content : "");
+    return _impl;
+}
+
+MgStorage* MgJsonReader::storageForRead(FILE* fp)
+{
+    _impl->open(fp, NULL);
+    return _impl;
+}
+
+void MgJsonReader::clear()
+{
+    _impl->clear();
+}
+
+const char* MgJsonReader::getParseError()
+{
+    return _impl->getError();
+}
+
+void MgJsonReader::Impl::reset()
+{
+    _fp = NULL;
+    _data = NULL;
+    _start = 0;
+    _base = 0;
+    _len = 0;
+    _pos = 0;
+    _stack.clear();
+}
+
+void MgJsonReader::Impl::clear()
+{
+    reset();
+}
+
+void MgJsonReader::Impl::open(FILE* fp, const char* content)
+{
+    reset();
+    _err = NULL;
+    _broken = false;
+    _fp = fp;
+    if (fp) {
+        _start = ftell(fp);
+    } else {
+        _data = content;
+        _len = (int)strlen(content);
+    }
+    
+    skipSpace();
+    if (get() != '{') {
+        syntaxError("The root of JSON must be an object.");
+        reset();
+    } else {
+        _stack.push_back(MgJsonFrame());        // 根对象
+    }
+}
+
+bool MgJsonReader::Impl::fill()
+{
+    if (!_fp) {
+        return false;                           // 内存方式已是全部内容
+    }
+    _base += _len;
+    _pos = 0;
+    _len = (int)fread(_buf, 1, sizeof(_buf), _fp);
+    _data = _buf;
+    if (_len < 0) {
+        _len = 0;
+    }
+    return _len > 0;
+}
+
+void MgJsonReader::Impl::seek(long offset)
+{
+    if (offset >= _base && offset < _base + _len) {
+        _pos = (int)(offset - _base);
+    } else if (_fp) {
+        fseek(_fp, _start + offset, SEEK_SET);
+        _base = offset;
+        _len = 0;
+        _pos = 0;
+    }
+}
+
+void MgJsonReader::Impl::skipSpace()
+{
+    for (int c = peek(); c == ' ' || c == '\t' || c == '\r' || c == '\n'; c = peek()) {
+        _pos++;
+    }
+}
+
+static void appendUtf8(std::string& str, unsigned code)
+{
+    if (code < 0x80) {
+        str += (char)code;
+    } else if (code < 0x800) {
+        str += (char)(0xC0 | (code >> 6));
+        str += (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        str += (char)(0xE0 | (code >> 12));
+        str += (char)(0x80 | ((code >> 6) & 0x3F));
+        str += (char)(0x80 | (code & 0x3F));
+    } else {
+        str += (char)(0xF0 | (code >> 18));
+        str += (char)(0x80 | ((code >> 12) & 0x3F));
+        str += (char)(0x80 | ((code >> 6) & 0x3F));
+        str += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+bool MgJsonReader::Impl::parseString(std::string& str)
+{
+    str.clear();
+    if (get() != '"') {
+        return syntaxError("Missing a string.");
+    }
+    for (int c = get(); c != '"'; c = get()) {
+        if (c < 0) {
+            return syntaxError("Missing a closing quotation mark in string.");
+        }
+        if (c != '\\') {
+            str += (char)c;
+            continue;
+        }
+        switch (c = get()) {
+            case 'b': str += '\b'; break;
+            case 'f': str += '\f'; break;
+            case 'n': str += '\n'; break;
+            case 'r': str += '\r'; break;
+            case 't': str += '\t'; break;
+            case 'u': {
+                char hex[5] = { 0 };
+                for (int i = 0; i < 4; i++) {
+                    hex[i] = (char)get();
+                }
+                unsigned code = (unsigned)strtoul(hex, NULL, 16);
+                if (code >= 0xD800 && code < 0xDC00 && peek() == '\\') {   // 代理对
+                    get();
+                    get();
+                    for (int i = 0; i < 4; i++) {
+                        hex[i] = (char)get();
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10)
+                        + ((unsigned)strtoul(hex, NULL, 16) - 0xDC00);
+                }
+                appendUtf8(str, code);
+                break;
+            }
+            default:
+                if (c < 0) {
+                    return syntaxError("Invalid escape character in string.");
+                }
+                str += (char)c;                 // 引号、斜杠和反斜杠
+                break;
+        }
+    }
+    return true;
+}
+
+bool MgJsonReader::Impl::parseNumber(MgJsonValue* value)
+{
+    char buf[64];
+    int n = 0;
+    bool isInt = true;
+    
+    for (int c = peek(); (c >= '0' && c <= '9') || c == '-' || c == '+'
+         || c == '.' || c == 'e' || c == 'E'; c = peek()) {
+        if (c == '.' || c == 'e' || c == 'E') {
+            isInt = false;
+        }
+        if (n < (int)sizeof(buf) - 1) {
+            buf[n++] = (char)c;
+        }
+        _pos++;
+    }
+    buf[n] = 0;
+    if (n == 0) {
+        return syntaxError("Invalid value.");
+    }
+    if (value) {
+        value->type = isInt ? 'i' : 'f';
+        value->number = strtod(buf, NULL);
+    }
+    return true;
+}
+
+bool MgJsonReader::Impl::parseLiteral(const char* word)
+{
+    for (; *word; word++) {
+        if (get() != *word) {
+            return syntaxError("Invalid value.");
+        }
+    }
+    return true;
+}
+
+bool MgJsonReader::Impl::parseValue(MgJsonValue* value)
+{
+    std::string tmp;
+    MgJsonValue item;
+    int c;
+    
+    skipSpace();
+    switch (peek()) {
+        case '"':
+            if (value) {
+                value->type = 's';
+                return parseString(value->str);
+            }
+            return parseString(tmp);
+            
+        case 't':
+            if (value)
+                value->type = 't';
+            return parseLiteral("true");
+            
+        case 'f':
+            if (value)
+                value->type = 'b';
+            return parseLiteral("false");
+            
+        case 'n':
+            if (value)
+                value->type = 'n';
+            return parseLiteral("null");
+            
+        case '[':                               // 数组只保留数值元素
+            get();
+            if (value) {
+                value->type = 'a';
+                value->arr.clear();
+            }
+            skipSpace();
+            if (peek() == ']') {
+                get();
+                return true;
+            }
+            for (;;) {
+                item.type = 'n';
+                if (!parseValue(value ? &item : NULL)) {
+                    return false;
+                }
+                if (value) {
+                    value->arr.push_back(item.type == 'i' || item.type == 'f'
+                                         ? (float)item.number : 0.f);
+                }
+                skipSpace();
+                c = get();
+                if (c == ']') {
+                    return true;
+                }
+                if (c != ',') {
+                    return syntaxError("Missing a comma or ']' after an array element.");
+                }
+            }
+            
+        case '{':                               // 数组中的对象不读取，跳过
+            get();
+            skipSpace();
+            if (peek() == '}') {
+                get();
+                return true;
+            }
+            for (;;) {
+                skipSpace();
+                if (!parseString(tmp)) {
+                    return false;
+                }
+                skipSpace();
+                if (get() != ':') {
+                    return syntaxError("Missing a colon after a name of object member.");
+                }
+                if (!parseValue(NULL)) {
+                    return false;
+                }
+                skipSpace();
+                c = get();
+                if (c == '}') {
+                    return true;
+                }
+                if (c != ',') {
+                    return syntaxError("Missing a comma or '}' after an object member.");
+                }
+            }
+            
+        default:
+            return parseNumber(value);
+    }
+}
+
+bool MgJsonReader::Impl::advance(MgJsonFrame& frame, bool store)
+{
+    if (frame.closed) {
+        return false;
+    }
+    if (!frame.pending.empty()) {               // 跳过未进入的子节点，记下位置
+        if (store) {
+            frame.skipped[frame.pending] = tell();
+        }
+        frame.pending.clear();
+        if (!parseValue(NULL)) {
+            frame.closed = true;
+            return false;
+        }
+    }
+    
+    skipSpace();
+    int c = peek();
+    
+    if (c == ',') {
+        get();
+        skipSpace();
+        c = peek();
+    }
+    if (c == '}') {
+        get();
+        frame.closed = true;
+        return false;
+    }
+    
+    std::string name;
+    bool ret = parseString(name);
+    
+    skipSpace();
+    if (ret && get() != ':') {
+        ret = syntaxError("Missing a colon after a name of object member.");
+    }
+    skipSpace();
+    if (ret && peek() == '{') {                 // 子节点等要读取时再进入
+        frame.pending = name;
+    } else if (ret) {
+        ret = parseValue(store ? &frame.values[name] : NULL);
+    }
+    if (!ret) {
+        frame.closed = true;
+    }
+    
+    return ret;
+}
+
+bool MgJsonReader::Impl::enterNode(const char* name, long resume)
+{
+    get();                                      // 跳过 '{'
+    _stack.push_back(MgJsonFrame());
+    _stack.back().name = name;
+    _stack.back().resume = resume;
+    return true;
+}
+
+bool MgJsonReader::Impl::readNode(const char* name, int index, bool ended)
+{
+    if (_stack.empty()) {
+        return false;
+    }
+    if (!ended) {                               // 开始一个新节点
+        char tmpname[32];
+        if (index >= 0) {                       // 形成实际节点名称
+#if defined(_MSC_VER) && _MSC_VER >= 1400 // VC8
+            sprintf_s(tmpname, sizeof(tmpname), "%s%d", name, index + 1);
+#else
+            snprintf(tmpname, sizeof(tmpname), "%s%d", name, index + 1);
+#endif
+            name = tmpname;
+        }
+        
+        MgJsonFrame& parent = _stack.back();
+        
+        for (;;) {
+            if (parent.pending == name) {       // 顺序读取，就在当前位置
+                parent.pending.clear();
+                return enterNode(name, -1);
+            }
+            
+            std::map<std::string, long>::const_iterator it = parent.skipped.find(name);
+            
+            if (it != parent.skipped.end()) {   // 已扫描过，回到其位置，读完再返回
+                long resume = tell();
+                seek(it->second);
+                return enterNode(name, resume);
+            }
+            if (!advance(parent, true)) {
+                return false;                   // 没有此节点
+            }
+        }
+    }
+    
+    if (_stack.size() > 1) {                    // 当前节点读取完成
+        MgJsonFrame& frame = _stack.back();
+        long resume = frame.resume;
+        std::string closed;
+        
+        while (advance(frame, false)) ;         // 跳到节点结尾
+        closed.swap(frame.name);
+        _stack.pop_back();
+        _stack.back().skipped.erase(closed);    // 读过的子节点不再保留位置，顺序读取时内存不增长
+        if (resume >= 0) {
+            seek(resume);
+        }
+    }
+    if (_stack.size() < 2) {                    // 根节点已读完
+        clear();
+    }
+    
+    return true;
+}
+
+bool MgJsonReader::Impl::setError(const char* err)
+{
+    _err = err;
+    if (err) {
+        LOGE("storage error: %s", err);
+    }
+    return false;
+}
+
+bool MgJsonReader::Impl::syntaxError(const char* err)
+{
+    _broken = true;
+    return setError(err);
+}
+
+const MgJsonValue* MgJsonReader::Impl::findValue(const char* name)
+{
+    if (_stack.size() < 2) {
+        return NULL;
+    }
+    
+    MgJsonFrame& frame = _stack.back();
+    
+    for (;;) {
+        std::map<std::string, MgJsonValue>::const_iterator it = frame.values.find(name);
+        
+        if (it != frame.values.end()) {
+            return &it->second;
+        }
+        if (!advance(frame, true)) {            // 向后扫描，直到找到或节点结束
+            return NULL;
+        }
+    }
+}
+
+static inline bool parseInt(const char* str, int& value)
+{
+    char *endptr;
+    value = (int)strtoul(str, &endptr, 0);
+    return !endptr || !*endptr;
+}
+
+int MgJsonReader::Impl::readInt(const char* name, int defvalue)
+{
+    const MgJsonValue* item = findValue(name);
+    int ret = defvalue;
+    
+    if (item) {
+        if (item->type == 'i') {
+            ret = item->number < 0 ? (int)item->number : (int)(unsigned)item->number;
+        }
+        else if (item->type == 's' && parseInt(item->str.c_str(), defvalue)) {
+            ret = defvalue;
+        }
+        else {
+            LOGD("Invalid value for readInt(%s)", name);
+        }
+    }
+    
+    return ret;
+}
+
+bool MgJsonReader::Impl::readBool(const char* name, bool defvalue)
+{
+    const MgJsonValue* item = findValue(name);
+    bool ret = defvalue;
+    
+    if (item) {
+        if (item->type == 't' || item->type == 'b') {
+            ret = (item->type == 't');
+        }
+        else {
+            LOGD("Invalid value for readBool(%s)", name);
+        }
+    }
+    
+    return ret;
+}
+
+float MgJsonReader::Impl::readFloat(const char* name, float defvalue)
+{
+    const MgJsonValue* item = findValue(name);
+    float ret = defvalue;
+    
+    if (item) {
+        if (item->type == 'f' || item->type == 'i') {
+            ret = (float)item->number;
+        }
+        else {
+            LOGD("Invalid value for readFloat(%s)", name);
+        }
+    }
+    
+    return ret;
+}
+
+int MgJsonReader::Impl::readFloatArray(const char* name, float* values, int count, bool report)
+{
+    const MgJsonValue* item = findValue(name);
+    int ret = 0;
+    
+    report = report && count > 0 && values;
+    if (item) {
+        if (item->type == 'a') {
+            ret = (int)item->arr.size();
+            if (values) {
+                ret = ret < count ? ret : count;
+                for (int i = 0; i < ret; i++) {
+                    values[i] = item->arr[i];
+                }
+            }
+        }
+        else if (report) {
+            LOGD("Invalid value for readFloatArray(%s)", name);
+        }
+    }
+    if (values && ret < count && report) {
+        setError("readFloatArray: lose numbers.");
+    }
+    
+    return ret;
+}
+
+int MgJsonReader::Impl::readString(const char* name, char* value, int count)
+{
+    const MgJsonValue* item = findValue(name);
+    int ret = 0;
+    
+    if (item) {
+        if (item->type == 's') {
+            ret = (int)item->str.size();
+            if (value) {
+                ret = ret < count ? ret : count;
+                memcpy(value, item->str.c_str(), ret);
+            }
+        }
+        else {
+            LOGD("Invalid value for readString(%s)", name);
+        }
+    }
+    
+    return ret;
+}
@@ -0,0 +1,132 @@
+﻿// mgmappedfile.cpp
+// Copyright (c) 2004-2014, Zhang Yungui
+// License: LGPL, https://github.com/rhcad/touchvg
+
+#include "mgmappedfile.h"
+#include "mglog.h"
+
+#if defined(__WINDOWS__) || defined(WIN32)
+#ifndef _WINDOWS_
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#endif
+
+MgMappedFile::MgMappedFile() : _data(NULL), _size(0), _opened(false)
+{
+    _handle[0] = _handle[1] = NULL;
+}
+
+MgMappedFile::~MgMappedFile()
+{
+    close();
+}
+
+#if defined(__WINDOWS__) || defined(WIN32)
+
+bool MgMappedFile::open(const char* filename)
+{
+    close();
+    
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    
+    DWORD size = GetFileSize(file, NULL);
+    HANDLE mapping = size > 0 ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    
+    _data = mapping ? (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (size > 0 && !_data) {
+        LOGE("Fail to map file: %s", filename);
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    _handle[0] = file;
+    _handle[1] = mapping;
+    _size = (int)size;
+    _opened = true;
+    
+    return true;
+}
+
+void MgMappedFile::close()
+{
+    if (_data) {
+        UnmapViewOfFile(_data);
+    }
+    if (_handle[1]) {
+        CloseHandle((HANDLE)_handle[1]);
+    }
+    if (_handle[0]) {
+        CloseHandle((HANDLE)_handle[0]);
+    }
+    _handle[0] = _handle[1] = NULL;
+    _data = NULL;
+    _size = 0;
+    _opened = false;
+}
+
+bool MgMappedFile::replaceFile(const char* srcfile, const char* destfile)
+{
+    // 目标文件正被映射时不能替换，返回false而不破坏其内容
+    return !!MoveFileExA(srcfile, destfile, MOVEFILE_REPLACE_EXISTING);
+}
+
+#else // POSIX
+
+bool MgMappedFile::open(const char* filename)
+{
+    close();
+    
+    int fd = ::open(filename, O_RDONLY);
+    struct stat st;
+    
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size > 0) {
+        void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) {
+            LOGE("Fail to map file: %s", filename);
+            ::close(fd);
+            return false;
+        }
+        _data = (const unsigned char*)p;
+    }
+    ::close(fd);                                // 映射后不再需要文件句柄
+    _size = (int)st.st_size;
+    _opened = true;
+    
+    return true;
+}
+
+void MgMappedFile::close()
+{
+    if (_data) {
+        munmap((void*)_data, (size_t)_size);
+    }
+    _data = NULL;
+    _size = 0;
+    _opened = false;
+}
+
+bool MgMappedFile::replaceFile(const char* srcfile, const char* destfile)
+{
+    return rename(srcfile, destfile) == 0;      // 原文件仍被映射时其内容保留到取消映射
+}
+
+#endif
@@ -0,0 +1,404 @@
+//! \file testbench.cpp
+//! \brief Implement the benchmark class: TestBench.
+// Copyright (c) 2012-2013, https://github.com/rhcad/touchvg
+
+#include "testbench.h"
+#include "gicoreview.h"
+#include "gicanvas.h"
+#include "githread.h"
+#include "mglog.h"
+#include "mgshapedoc.h"
+#include "mgbasicspreg.h"
+#include "spfactoryimpl.h"
+#include "mgjsonstorage.h"
+#include "mgboxselector.h"
+#include "mgcurv.h"
+#include "RandomShape.h"
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <math.h>
+#include <vector>
+
+#ifdef NO_LOGD                                  // 没有日志输出的平台上也输出测试结果
+#undef LOGD
+#define LOGD(...)   (printf(__VA_ARGS__), printf("\n"))
+#endif
+
+//! 只计数不输出的画布，可模拟平台提供的主视图缓存位图
+class BenchCanvas : public GiCanvas
+{
+public:
+    BenchCanvas(bool cached) : cached(cached), cachedCount(0), drawCount(0) {}
+    
+    bool    cached;
+    int     cachedCount;
+    long    drawCount;
+    
+    void setPen(int, float, int, float, float) {}
+    void setBrush(int, int) {}
+    void clearRect(float, float, float, float) {}
+    void drawRect(float, float, float, float, bool, bool) { drawCount++; }
+    void drawLine(float, float, float, float) { drawCount++; }
+    void drawEllipse(float, float, float, float, bool, bool) { drawCount++; }
+    void beginPath() {}
+    void moveTo(float, float) {}
+    void lineTo(float, float) {}
+    void bezierTo(float, float, float, float, float, float) {}
+    void quadTo(float, float, float, float) {}
+    void closePath() {}
+    void drawPath(bool, bool) { drawCount++; }
+    void saveClip() {}
+    void restoreClip() {}
+    bool clipRect(float, float, float, float) { return true; }
+    bool clipPath() { return true; }
+    bool drawHandle(float, float, int) { return true; }
+    bool drawBitmap(const char*, float, float, float, float, float) { return true; }
+    float drawTextAt(const char*, float, float, float, int) { return 0; }
+    bool drawCachedBitmap(float, float, float, float, float, float, float, float) {
+        cachedCount += cached ? 1 : 0;
+        return cached;
+    }
+};
+
+float TestBench::magnifierDrag(bool cached, int frames)
+{
+    GiView mainView, magView;
+    BenchCanvas mainCanvas(false), canvas(cached);
+    GiCoreView* core = GiCoreView::createView(&mainView);
+    
+    core->onSize(&mainView, 1024, 768);
+    core->addShapesForTest();
+    core->zoomToExtent();
+    core->submitBackDoc(&mainView);
+    
+    mgvector<float> wnd(0.f, 0.f, 1024.f, 768.f);   // 主视图窗口对应的模型范围
+    core->displayToModel(wnd);
+    
+    const float sx = (wnd.get(2) - wnd.get(0)) / 1024.f;
+    const float sy = (wnd.get(3) - wnd.get(1)) / 768.f;
+    GiCoreView* mag = GiCoreView::createMagnifierView(&magView, core, &mainView);
+    
+    mag->onSize(&magView, 200, 200);
+    mag->twoFingersMove(&magView, kGiGestureBegan, 50, 100, 150, 100);  // 使放大镜成为当前视图
+    mag->twoFingersMove(&magView, kGiGestureEnded, 50, 100, 150, 100);
+    
+    double total = 0;
+    
+    for (int i = 0; i < frames; i++) {
+        float x = 512.f;
+        float y = 150.f + 618.f * i / frames;       // 放大镜中心从上方拖到主视图下边缘
+        
+        mag->zoomToModel(wnd.get(0) + (x - 50) * sx, wnd.get(3) - (y + 50) * sy,
+                         100 * sx, 100 * sy);       // 显示主视图中 100x100 的区域，即放大2倍
+        core->drawAll(&mainView, &mainCanvas);
+        
+        double t = giTickCount();
+        mag->drawAll(&magView, &canvas);
+        total += giTickCount() - t;
+    }
+    mag->release();
+    core->release();
+    
+    float ms = frames > 0 ? (float)(total / frames) : 0.f;
+    LOGD("magnifierDrag: cached=%d, %.3f ms/frame, %d frames from cached bitmap, %ld shapes drawn",
+         cached ? 1 : 0, ms, canvas.cachedCount, canvas.drawCount);
+    return ms;
+}
+
+float TestBench::jsonLoad(int count)
+{
+    MgShapeFactoryImpl factory;
+    MgShapeDoc* doc = MgShapeDoc::createDoc();
+    MgJsonStorage js;
+    
+    MgBasicShapes::registerShapes(&factory);
+    RandomParam(count).addShapes(doc->getCurrentShapes());
+    doc->save(js.storageForWrite(), 0);
+    
+    std::string content(js.stringify(false));
+    MgShapeDoc* newdoc = MgShapeDoc::createDoc();
+    MgJsonStorage reader;
+    double t = giTickCount();
+    
+    bool ret = newdoc->load(&factory, reader.storageForRead(content.c_str()), false);
+    float ms = (float)(giTickCount() - t);
+    int loaded = ret ? newdoc->getShapeCount() : 0;
+    int total = doc->getShapeCount();
+    
+    LOGD("jsonLoad: %d of %d shapes loaded, %d KB, %.1f ms, %.2f us/shape",
+         loaded, total, (int)(content.size() / 1024), ms, total > 0 ? ms * 1000.f / total : 0.f);
+    newdoc->release();
+    doc->release();
+    
+    return loaded == total ? ms : -1.f;
+}
+
+static long fileSize(const char* filename)
+{
+    FILE* fp = mgopenfile(filename, "rb");
+    long size = -1;
+    
+    if (fp) {
+        fseek(fp, 0, SEEK_END);
+        size = ftell(fp);
+        fclose(fp);
+    }
+    return size;
+}
+
+// 去掉各行的 flags 值，加载时按 isClosed() 设置的闭合标志在64位下不可靠
+static void removeFlags(std::string& content)
+{
+    const std::string key("\"flags\"");
+    
+    for (size_t pos = content.find(key); pos != content.npos; pos = content.find(key, pos)) {
+        size_t end = content.find('\n', pos);
+        content.erase(pos, end == content.npos ? end : end - pos);
+    }
+}
+
+// 得到前端文档中图形的JSON内容，不含标志位，文档的显示范围随视图变化而不比较
+static void getFrontContent(GiCoreView* core, GiView* view, std::string& content)
+{
+    content.clear();
+    if (core->submitBackDoc(view)) {
+        long doc = core->acquireFrontDoc();
+        content = core->getContent(doc);
+        core->freeContent();
+        GiCoreView::releaseDoc(doc);
+        removeFlags(content);
+        content.erase(0, content.find("\"shapes1\""));
+    }
+}
+
+// 比较两个JSON内容，数值的相对误差不超过 tol 即相同
+static bool sameContent(const std::string& content1, const std::string& content2, double tol)
+{
+    const char* a = content1.c_str();
+    const char* b = content2.c_str();
+    
+    if (content1.empty() || content2.empty()) {
+        return false;
+    }
+    while (*a && *b) {
+        if ((isdigit(*a) || *a == '-') && (isdigit(*b) || *b == '-')) {
+            char *enda, *endb;
+            double x = strtod(a, &enda);
+            double y = strtod(b, &endb);
+            
+            if (fabs(x - y) > tol * (1 + fabs(x))) {
+                return false;
+            }
+            a = enda;
+            b = endb;
+        }
+        else if (*a++ != *b++) {
+            return false;
+        }
+    }
+    return *a == *b;
+}
+
+// 从文件加载图形，返回加载毫秒数
+static float loadContent(GiCoreView* core, GiView* view, const char* filename,
+                         bool readOnly, std::string& content)
+{
+    double t = giTickCount();
+    bool ret = core->loadFromFile(filename, readOnly);
+    float ms = (float)(giTickCount() - t);
+    
+    getFrontContent(core, view, content);
+    if (!ret) {
+        content.clear();
+    }
+    return ms;
+}
+
+bool TestBench::binaryRoundTrip(const char* filename)
+{
+    std::string vgfile(std::string(filename) + ".vg");
+    std::string vgbfile(vgfile + "b");
+    GiView view;
+    GiCoreView* core = GiCoreView::createView(&view);
+    
+    core->onSize(&view, 1024, 768);
+    core->addShapesForTest();
+    
+    std::string saved, json, bin, lazy;             // 都与原图形比较，JSON文件只保留6位有效数字
+    getFrontContent(core, &view, saved);
+    
+    long doc = core->acquireFrontDoc();
+    double t = giTickCount();
+    bool ret = core->saveToFile(doc, vgfile.c_str(), false);
+    float jsonSaveMs = (float)(giTickCount() - t);
+    
+    t = giTickCount();
+    ret = core->saveToFile(doc, vgbfile.c_str()) && ret;
+    float binSaveMs = (float)(giTickCount() - t);
+    GiCoreView::releaseDoc(doc);
+    
+    float jsonLoadMs = loadContent(core, &view, vgfile.c_str(), false, json);
+    float binLoadMs = loadContent(core, &view, vgbfile.c_str(), false, bin);
+    float lazyLoadMs = loadContent(core, &view, vgbfile.c_str(), true, lazy);
+    int count = core->getShapeCount();
+    
+    ret = ret && sameContent(saved, json, 1e-5) && sameContent(saved, bin, 0)
+        && sameContent(saved, lazy, 0);
+    core->release();
+    
+    LOGD("binaryRoundTrip: %s, %d shapes, .vg %ld bytes saved in %.1f ms loaded in %.1f ms, "
+         ".vgb %ld bytes saved in %.1f ms loaded in %.1f ms (%.1f ms read-only)",
+         ret ? "same" : "different", count, fileSize(vgfile.c_str()), jsonSaveMs, jsonLoadMs,
+         fileSize(vgbfile.c_str()), binSaveMs, binLoadMs, lazyLoadMs);
+    return ret;
+}
+
+float TestBench::boxSelect(int count, bool intersect, int moves)
+{
+    MgShapeDoc* doc = MgShapeDoc::createDoc();
+    const MgShapes* shapes = doc->getCurrentShapes();
+    
+    RandomParam(count).addShapes(doc->getCurrentShapes());
+    
+    const Box2d ext(shapes->getExtent());
+    const Point2d start(ext.xmin + ext.width() * 0.3f, ext.ymin + ext.height() * 0.3f);
+    MgBoxSelector selector;
+    std::vector<int> ids, fullIds;
+    double scanTime = 0, indexTime = 0, firstTime = 0;
+    int changed = 0, selected = 0;
+    bool same = true;
+    
+    for (int i = 1; i <= moves; i++) {
+        float t = (float)i / moves;             // 角点横向扫过，纵向先远离再返回，选择框先变大后变小
+        Box2d box(start, Point2d(start.x + ext.width() * 0.6f * t,
+                                 start.y + ext.height() * 0.5f * sinf(t * _M_PI)));
+        
+        double tick = giTickCount();
+        MgShapeIterator it(shapes);
+        
+        fullIds.clear();
+        while (const MgShape* sp = it.getNext()) {
+            if (intersect ? sp->shapec()->hitTestBox(box) : box.contains(sp->shapec()->getExtent())) {
+                fullIds.push_back(sp->getID());
+            }
+        }
+        scanTime += giTickCount() - tick;
+        
+        tick = giTickCount();
+        changed += selector.update(shapes, box, intersect) ? 1 : 0;
+        selector.getSelection(ids);
+        tick = giTickCount() - tick;
+        if (i > 1) {
+            indexTime += tick;
+        } else {
+            firstTime = tick;                   // 第一次要建立索引，单独统计
+        }
+        
+        same = same && ids == fullIds;
+        selected += (int)ids.size();
+    }
+    
+    float ms = moves > 1 ? (float)(indexTime / (moves - 1)) : 0.f;
+    LOGD("boxSelect: %d shapes, intersect=%d, %s, %d moves (%d changed), %d selected per move, "
+         "%.3f ms/move after %.3f ms of the first move, full scan %.3f ms/move",
+         shapes->getShapeCount(), intersect ? 1 : 0, same ? "same" : "different", moves, changed,
+         moves > 0 ? selected / moves : 0, ms, firstTime, moves > 0 ? scanTime / moves : 0.0);
+    doc->release();
+    
+    return same ? ms : -1.f;
+}
+
+float TestBench::cyclicTriEquations(int n)
+{
+    if (n < 2) {
+        return -1.f;
+    }
+    
+    std::vector<float> a(n), b(n), c(n), mat(n * n, 0.f);
+    std::vector<Vector2d> vs(n), vs2(n);
+    int i;
+    
+    for (i = 0; i < n; i++) {                   // 主对角占优，与闭合样条的方程组相似
+        a[i] = RandomParam::RandF(0.5f, 1.5f);
+        b[i] = RandomParam::RandF(4.f, 5.f);
+        c[i] = RandomParam::RandF(0.5f, 1.5f);
+        vs[i] = vs2[i] = Vector2d(RandomParam::RandF(-100.f, 100.f), RandomParam::RandF(-100.f, 100.f));
+        mat[i * n + i] = b[i];
+    }
+    for (i = 0; i < n - 1; i++) {
+        mat[i * n + i + 1] += c[i];
+        mat[(i + 1) * n + i] += a[i];
+    }
+    mat[n - 1] += a[n - 1];                     // 右上角
+    mat[(n - 1) * n] += c[n - 1];               // 左下角
+    
+    double t = giTickCount();
+    bool ret = mgcurv::cyclicTriEquations(n, &a.front(), &b.front(), &c.front(), &vs.front());
+    float cyclicMs = (float)(giTickCount() - t);
+    
+    t = giTickCount();
+    ret = mgcurv::gaussJordan(n, &mat.front(), &vs2.front()) && ret;
+    float gaussMs = (float)(giTickCount() - t);
+    
+    float err = 0;
+    
+    for (i = 0; ret && i < n; i++) {
+        err = mgMax(err, fabsf(vs[i].x - vs2[i].x) / (1 + fabsf(vs2[i].x)));
+        err = mgMax(err, fabsf(vs[i].y - vs2[i].y) / (1 + fabsf(vs2[i].y)));
+    }
+    LOGD("cyclicTriEquations: n=%d, %s, max difference %g, %.3f ms, gaussJordan %.1f ms",
+         n, ret ? "solved" : "failed", err, cyclicMs, gaussMs);
+    
+    return ret ? err : -1.f;
+}
+
+float TestBench::closedSplines(int n)
+{
+    if (n < 2) {
+        return -1.f;
+    }
+    
+    std::vector<Point2d> knots(n);
+    std::vector<Vector2d> knotvs(n);
+    int i, n1 = n - 1;
+    
+    for (i = 0; i < n; i++) {                   // 沿圆周稍有起伏的型值点
+        knots[i] = Point2d::kOrigin().polarPoint(_M_2PI * i / n, 100.f + RandomParam::RandF(-5.f, 5.f));
+    }
+    
+    double t = giTickCount();
+    bool ret = mgcurv::cubicSplines(n, &knots.front(), &knotvs.front(), mgcurv::cubicLoop);
+    float ms = (float)(giTickCount() - t);
+    float err = 0;
+    
+    if (ret && n <= 512) {                      // 与原来的稠密矩阵解法比较
+        std::vector<float> mat(n * n, 0.f);
+        std::vector<Vector2d> vs(n);
+        
+        mat[n1] = 1.f;
+        mat[0] = 4.f;
+        mat[1] = 1.f;
+        mat[n1*n+n1 - 1] = 1.f;
+        mat[n1*n+n1] = 4.f;
+        mat[n1*n+0] = 1.f;
+        vs[0] = (knots[1] - knots[n1]) * 3.f;
+        vs[n1] = (knots[0] - knots[n1 - 1]) * 3.f;
+        for (i = 1; i < n1; i++) {
+            mat[i*n+i-1] = 1.f;
+            mat[i*n+i] = 4.f;
+            mat[i*n+i+1] = 1.f;
+            vs[i] = (knots[i+1] - knots[i-1]) * 3.f;
+        }
+        ret = mgcurv::gaussJordan(n, &mat.front(), &vs.front());
+        for (i = 0; ret && i < n; i++) {
+            err = mgMax(err, (knotvs[i] - vs[i]).length() / (1 + vs[i].length()));
+        }
+        ret = ret && err < 1e-4f;
+    }
+    
+    LOGD("closedSplines: %d knots, %s, %.3f ms, max difference %g",
+         n, ret ? "solved" : "failed", ms, err);
+    return ret ? ms : -1.f;
+}
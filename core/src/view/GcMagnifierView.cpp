@@ -2,12 +2,34 @@
 // Copyright (c) 2012-2013, https://github.com/rhcad/touchvg
 
 #include "GcMagnifierView.h"
+#include "gicanvas.h"
 
 GcMagnifierView::GcMagnifierView(MgView* mgview, GiView *view, GcGraphView* mainView)
-    : GcBaseView(mgview, view), _mainView(mainView)
+    : GcBaseView(mgview, view), _mainView(mainView), _maxCachedScale(2.f)
 {
 }
 
 GcMagnifierView::~GcMagnifierView()
 {
 }
+
+bool GcMagnifierView::drawCachedBitmap(GiCanvas* canvas)
+{
+    if (!canvas || !_mainView || _mainView->isZooming()) {  // 主视图放缩中其位图不可用
+        return false;
+    }
+    
+    const GiTransform& mainxf = _mainView->frontGraph()->xf();
+    Box2d rect(xform()->getWndRectM() * mainxf.modelToDisplay()); // 本视图在主视图中的区域
+    
+    if (rect.isEmpty() || !mainxf.getWndRect().contains(rect)) {  // 超出部分不在位图中，需重新绘制
+        return false;
+    }
+    
+    Box2d dest(rect * mainxf.displayToModel() * xform()->modelToDisplay());
+    float scale = dest.width() / rect.width();
+    
+    return scale <= _maxCachedScale             // 放大倍数过大时位图模糊，需重新绘制
+        && canvas->drawCachedBitmap(rect.xmin, rect.ymin, rect.width(), rect.height(),
+                                    dest.xmin, dest.ymin, dest.width(), dest.height());
+}
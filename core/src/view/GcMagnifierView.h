@@ -16,8 +16,15 @@ public:
     GcMagnifierView(MgView* mgview, GiView *view, GcGraphView* mainView);
     virtual ~GcMagnifierView();
     
+    //! 设置复用主视图位图的最大放大倍数，超过则重新绘制图形
+    void setMaxCachedScale(float scale) { _maxCachedScale = scale; }
+    
+    //! 将主视图已显示的缓存位图放大显示到本视图，返回false表示需要重新绘制图形
+    bool drawCachedBitmap(GiCanvas* canvas);
+    
 private:
-    GcGraphView*     _mainView;
+    GcGraphView*    _mainView;
+    float           _maxCachedScale;
 };
 
 #endif // TOUCHVG_CORE_MAGNIFIERVIEW_H
@@ -24,7 +24,12 @@ bool GiCoreView::startRecord(const char* path, long doc, bool forUndo,
     MgRecordShapes* p = new MgRecordShapes(path, MgShapeDoc::fromHandle(doc), forUndo, curTick);
     impl->setRecorder(forUndo, p);
     
-    if (isPlaying() || forUndo) {
+    if (isPlaying()) {
+        // 在预读线程中解析后续帧并创建图形
+        p->startPrefetch(impl->getShapeFactory(), MgShapeDoc::fromHandle(doc));
+        return true;
+    }
+    if (forUndo) {
         return true;
     }
     
@@ -38,14 +43,34 @@ bool GiCoreView::startRecord(const char* path, long doc, bool forUndo,
     return true;
 }
 
-void GiCoreView::stopRecord(bool forUndo)
+void GiCoreView::stopRecord(bool forUndo, MgStringCallback* c)
 {
+    MgRecordShapes* recorder = impl->recorder(forUndo);
+    
+    if (recorder && c) {
+        std::string filename;
+        recorder->stopRecordIndex();            // 等写线程写完队列中的帧
+        while (recorder->popWrittenFile(filename)) {
+            c->onGetString(filename.c_str());
+        }
+    }
     impl->setRecorder(forUndo, NULL);
     if (!forUndo && impl->play.playing) {
         impl->play.playing->clear();
     }
 }
 
+int GiCoreView::seekRecord(long doc, long shapes, int tick)
+{
+    MgRecordShapes* player = impl->recorder(false);
+    MgShapeDoc* backDoc = MgShapeDoc::fromHandle(doc);
+    
+    if (!player || !player->isPlaying() || !backDoc) {
+        return 0;
+    }
+    return player->seekTo(impl->getShapeFactory(), backDoc, MgShapes::fromHandle(shapes), tick);
+}
+
 bool GiCoreView::recordShapes(bool forUndo, long tick, long doc, long shapes)
 {
     return recordShapes(forUndo, tick, doc, shapes, NULL);
@@ -69,8 +94,10 @@ bool GiCoreView::recordShapes(bool forUndo, long tick, long doc,
     if (recorder && !recorder->isLoading() && !recorder->isPlaying()) {
         ret = recorder->recordStep(tick, impl->changeCount, MgShapeDoc::fromHandle(doc),
                                    MgShapes::fromHandle(shapes), arr) ? 2 : 1;
-        if (ret > 1 && c) {
-            c->onGetString(recorder->getFileName(false, recorder->getFileCount() - 1).c_str());
+        
+        std::string filename;
+        while (c && recorder->popWrittenFile(filename)) {   // 写线程已写出的帧
+            c->onGetString(filename.c_str());
         }
     } else {
         GiPlaying::releaseDoc(doc);
@@ -101,6 +128,15 @@ bool GiCoreView::restoreRecord(int type, const char* path, long doc, long change
     return true;
 }
 
+bool GiCoreView::setUndoMemoryBudget(int bytes, bool spillOnStop)
+{
+    MgRecordShapes* recorder = impl->recorder(true);
+    if (recorder) {
+        recorder->setMemoryBudget(bytes, spillOnStop);
+    }
+    return recorder != NULL;
+}
+
 bool GiCoreView::isUndoLoading() const
 {
     return impl->recorder(true) && impl->recorder(true)->isLoading();
@@ -6,11 +6,19 @@
 #include "gicoreviewimpl.h"
 #include "RandomShape.h"
 #include "mgselect.h"
+#include "mgcmddraw.h"
+#include "mgdrawfreelines.h"
+#include "mgsnap.h"
 #include "mgbasicsp.h"
 #include "girecordcanvas.h"
 #include "mgbasicspreg.h"
 #include "svgcanvas.h"
+#include "mgjsonreader.h"
+#include "mgjsonwriter.h"
+#include "mgbinstorage.h"
+#include "mgmappedfile.h"
 #include "../corever.h"
+#include <set>
 
 static int _dpi = 96;
 float GiCoreViewImpl::_factor = 1.0f;
@@ -31,7 +39,7 @@ GcBaseView::GcBaseView(MgView* mgview, GiView *view)
 GiCoreViewImpl::GiCoreViewImpl(GiCoreView* owner, bool useView)
     : _cmds(NULL), curview(NULL), refcount(1)
     , gestureHandler(0), regenPending(-1), appendPending(-1), redrawPending(-1)
-    , changeCount(0), drawCount(0), stopping(0)
+    , changeCount(0), drawCount(0), stopping(0), dynPrefix(NULL), dynPieces(0)
 {
     memset(&gsBuf, 0, sizeof(gsBuf));
     memset((void*)&gsUsed, 0, sizeof(gsUsed));
@@ -62,9 +70,36 @@ GiCoreViewImpl::~GiCoreViewImpl()
         delete gsBuf[i];
     }
     MgObject::release_pointer(_cmds);
+    MgObject::release_pointer(dynPrefix);
     delete _gcdoc;
 }
 
+int GiCoreViewImpl::removeShapes(const int* ids, int count)
+{
+    MgShapes* s = shapes();
+    std::vector<const MgShape*> arr;
+    std::vector<int> sids;
+    std::set<int> checked;
+    int n = 0;
+    
+    hideContextActions();
+    for (int i = 0; i < count; i++) {                   // 先一次性检查图形是否可删除，重复的ID只算一次
+        const MgShape* shape = s->findShape(ids[i]);
+        if (shape && !shape->shapec()->getFlag(kMgShapeLocked)
+            && checked.insert(ids[i]).second && shapeWillDeleted(shape)) {
+            arr.push_back(shape);
+            sids.push_back(ids[i]);
+        }
+    }
+    if (!arr.empty()) {
+        getCmdSubject()->onShapesDeleted(motion(), (int)arr.size(), &arr.front());
+        n = s->removeShapes(&sids.front(), (int)sids.size());
+        CALL_VIEW(deviceView()->shapesDeleted(mgvector<int>(&sids.front(), (int)sids.size())));
+    }
+    
+    return n;
+}
+
 void GiCoreViewImpl::calcContextButtonPosition(mgvector<float>& pos, int n, const Box2d& box)
 {
     Box2d selbox(box);
@@ -483,6 +518,11 @@ void GiCoreView::releaseGraphics(long hGs)
 }
 
 int GiCoreView::drawAll(GiView* view, GiCanvas* canvas) {
+    GcMagnifierView* magview = dynamic_cast<GcMagnifierView*>(impl->_gcdoc->findView(view));
+    if (magview && magview->drawCachedBitmap(canvas)) {    // 放大镜复用主视图的显示结果
+        return 0;
+    }
+    
     long doc = acquireFrontDoc();
     long hGs = acquireGraphics(view);
     int n = drawAll(doc, hGs, canvas);
@@ -842,14 +882,22 @@ bool GiCoreView::submitDynamicShapes(GiView* view)
 void GiCoreViewImpl::submitDynamicShapes(GcBaseView* v)
 {
     MgCommand* cmd = getCommand();
-    MgShapes* shapes = drawing->getBackShapes(true);
+    MgShapes* shapes = cmd ? submitDynamicIncrement(cmd) : NULL;
+    bool gathered = !!shapes;
     
+    if (!shapes) {
+        shapes = drawing->getBackShapes(true);
+    }
     if (cmd) {
-        if (!cmd->gatherShapes(motion(), shapes)) {
+        if (gathered || !cmd->gatherShapes(motion(), shapes)) {
             GiRecordCanvas canvas(shapes, v->xform(), cmd->isDrawingCommand() ? 0 : -1);
             if (v->frontGraph()->beginPaint(&canvas)) {
                 mgCopy(motion()->d2mgs, cmds()->displayMmToModel(1, v->frontGraph()));
-                cmd->draw(motion(), v->frontGraph());
+                if (gathered) {         // 折线已分片提交，只显示捕捉标记等附加内容
+                    getSnap()->drawSnap(motion(), v->frontGraph());
+                } else {
+                    cmd->draw(motion(), v->frontGraph());
+                }
                 if (cmd->isDrawingCommand()) {
                     getCmdSubject()->drawInShapeCommand(motion(), cmd, v->frontGraph());
                 }
@@ -861,6 +909,82 @@ void GiCoreViewImpl::submitDynamicShapes(GcBaseView* v)
     }
 }
 
+static const int kDynPieceSize = 256;   // 动态折线的每个固定片段至少包含的新点数
+
+static MgShape* createLinesPiece(const MgShape* src, int from, int to)
+{
+    MgShape* p = MgShapeT<MgLines>::create();
+    MgBaseLines* lines = (MgBaseLines*)p->shape();
+    
+    p->setContext(src->context());
+    lines->resize(to - from);
+    for (int i = from; i < to; i++) {
+        lines->setPoint(i - from, src->shapec()->getPoint(i));
+    }
+    lines->update();
+    
+    return p;
+}
+
+// 绘制自由折线时只追加新点，则之前提交的折线片段保留在动态图形列表中，
+// 只生成新的片段和末尾变化的部分，不必每帧复制和显示整条折线。
+// 只用于自由折线命令，其 draw() 除图形外只显示捕捉标记，其他命令有各自的提示内容。
+// 返回已放入折线片段的动态图形列表，不能增量提交则返回NULL
+MgShapes* GiCoreViewImpl::submitDynamicIncrement(MgCommand* cmd)
+{
+    MgCommandDraw* drawcmd = isCommand(MgCmdDrawFreeLines::Name()) ? (MgCommandDraw*)cmd : NULL;
+    const MgShape* sp = drawcmd && drawcmd->getStep() > 0 ? drawcmd->getShape(motion()) : NULL;
+    
+    if (!sp || sp->shapec()->getType() != MgLines::Type()
+        || sp->shapec()->isClosed() || sp->shapec()->getPointCount() < 2
+        || sp->context().getLineStyle() != GiContext::kSolidLine
+        || recorder(false)) {                       // 录制时需要完整的动态图形
+        MgObject::release_pointer(dynPrefix);
+        dynPieces = 0;
+        return NULL;
+    }
+    
+    const MgBaseLines* lines = (const MgBaseLines*)sp->shapec();
+    MgBaseLines* prefix = dynPrefix ? (MgBaseLines*)dynPrefix->shape() : NULL;
+    MgShapes* shapes;
+    
+    if (prefix && dynPrefix->context() == sp->context()
+        && lines->isIncrementFrom(*prefix)) {       // 之前提交的点都没变
+        std::vector<int> ids;
+        MgShapeIterator it(shapes = drawing->getBackShapes(false));
+        
+        for (int i = 0; const MgShape* p = it.getNext(); i++) {
+            if (i >= dynPieces)                     // 去掉上一帧的末尾部分和其他动态图形
+                ids.push_back(p->getID());
+        }
+        shapes->removeShapes(ids.empty() ? NULL : &ids.front(), (int)ids.size());
+    } else {
+        shapes = drawing->getBackShapes(true);
+        MgObject::release_pointer(dynPrefix);
+        dynPrefix = MgShapeT<MgLines>::create();
+        dynPrefix->setContext(sp->context());
+        prefix = (MgBaseLines*)dynPrefix->shape();
+        prefix->resize(0);
+        dynPieces = 0;
+    }
+    
+    int n = lines->getPointCount();
+    int count = prefix->getPointCount();
+    int overlap = sp->context().getLineAlpha() < 255 ? 1 : 2;   // 与前一片段重叠以便连接
+    
+    if (n - 1 - count >= kDynPieceSize) {           // 最后一点还会变，其余点固定为新片段
+        shapes->addShapeDirect(createLinesPiece(sp, mgMax(0, count - overlap), n - 1));
+        for (int i = count; i < n - 1; i++) {
+            prefix->addPoint(lines->getPoint(i));
+        }
+        count = n - 1;
+        dynPieces++;
+    }
+    shapes->addShapeDirect(createLinesPiece(sp, mgMax(0, count - overlap), n));
+    
+    return shapes;
+}
+
 void GiCoreView::clear()
 {
     loadShapes((MgStorage*)0);
@@ -889,14 +1013,22 @@ bool GiCoreView::setContent(const char* content)
 
 bool GiCoreView::loadFromFile(const char* vgfile, bool readOnly)
 {
-    FILE *fp = mgopenfile(vgfile, "rt");
+    FILE *fp = mgopenfile(vgfile, "rb");
     if (!fp) {
         LOGE("Fail to open file: %s", vgfile);
         return loadShapes(NULL, readOnly) && fp;
     }
     
-    MgJsonStorage s;
-    bool ret = loadShapes(s.storageForRead(fp), readOnly);
+    bool ret;
+    
+    if (MgBinStorage::isBinaryFile(fp)) {       // 二进制格式直接读映射的文件内容，只读时图形延迟加载
+        MgBinStorage s;
+        MgStorage* storage = s.storageForMapping(vgfile, readOnly);
+        ret = loadShapes(storage ? storage : s.storageForRead(fp), readOnly);
+    } else {
+        MgJsonReader s;                         // 边解析边加载图形，不构造整个文档树
+        ret = loadShapes(s.storageForRead(fp), readOnly);
+    }
 
     if (fp) {
         fclose(fp);
@@ -906,17 +1038,37 @@ bool GiCoreView::loadFromFile(const char* vgfile, bool readOnly)
     return ret;
 }
 
+static bool isBinaryFileName(const char* filename)
+{
+    size_t len = filename ? strlen(filename) : 0;
+    return len > 4 && (strcmp(filename + len - 4, ".vgb") == 0
+                       || strcmp(filename + len - 4, ".VGB") == 0);
+}
+
 bool GiCoreView::saveToFile(long doc, const char* vgfile, bool pretty)
 {
-    FILE *fp = doc ? mgopenfile(vgfile, "wt") : NULL;
-    MgJsonStorage s;
-    bool ret = (fp != NULL
-                && saveShapes(doc, s.storageForWrite())
-                && s.save(fp, pretty));
+    bool binary = isBinaryFileName(vgfile);     // 扩展名为.vgb时保存为二进制格式
+    std::string tmpfile(vgfile ? vgfile : "");
+    
+    tmpfile += ".tmp";                          // 原文件可能正被映射以延迟加载图形，不能直接截断
+    FILE *fp = doc && vgfile ? mgopenfile(tmpfile.c_str(), binary ? "wb" : "wt") : NULL;
+    bool ret = false;
+    
+    if (fp && binary) {
+        MgBinStorage s;
+        ret = saveShapes(doc, s.storageForWrite()) && s.save(fp);
+    } else if (fp) {
+        MgJsonWriter w;
+        ret = saveShapes(doc, w.storageForWrite(fp, pretty)) && w.finish();
+    }
     
     if (fp) {
         fclose(fp);
-        LOGD("saveToFile: %s", vgfile);
+        ret = ret && MgMappedFile::replaceFile(tmpfile.c_str(), vgfile);
+        if (!ret) {
+            remove(tmpfile.c_str());
+        }
+        LOGD("saveToFile: %d, %s", ret, vgfile);
     } else {
         LOGE("Fail to open file: %s", vgfile);
     }
@@ -88,6 +88,9 @@ public:
     volatile long   gsUsed[20];
     volatile long   stopping;
     
+    MgShape*        dynPrefix;      // 已作为动态图形片段提交的折线前部
+    int             dynPieces;      // 动态图形列表开头的折线片段数
+    
 public:
     GiCoreViewImpl(GiCoreView* owner, bool useView = true);
     ~GiCoreViewImpl();
@@ -166,6 +169,7 @@ public:
         }
         return ret;
     }
+    int removeShapes(const int* ids, int count);
     
     bool useFinger() {
         return CALL_VIEW2(deviceView()->useFinger(), true);
@@ -268,6 +272,7 @@ public:
     
     bool gestureToCommand();
     void submitDynamicShapes(GcBaseView* v);
+    MgShapes* submitDynamicIncrement(MgCommand* cmd);
     
 private:
     void registerShape(int type, MgShape* (*creator)()) {